@@ -0,0 +1,462 @@
+/*
+* Copyright (c) 2006-2009 Erin Catto http://www.gphysics.com
+*
+* Permission to use, copy, modify, distribute and sell this software
+* and its documentation for any purpose is hereby granted without fee,
+* provided that the above copyright notice appear in all copies.
+* Erin Catto makes no representations about the suitability
+* of this software for any purpose.
+* It is provided "as is" without express or implied warranty.
+*/
+
+#include <stdio.h>
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <set>
+#include <utility>
+
+#include "checks.h"
+#include "box2d-lite/World.h"
+#include "box2d-lite/Body.h"
+#include "box2d-lite/SceneBuilder.h"
+
+namespace
+{
+	float timeStep = 1.0f / 60.0f;
+	Vec2 gravity(0.0f, -10.0f);
+}
+
+typedef std::pair<Body*, Body*> BodyPair;
+
+// Unordered, and by address: the world orders its keys by proxy id, which
+// a removed body loses.
+static BodyPair MakePair(Body* b1, Body* b2)
+{
+	return b1 < b2 ? BodyPair(b1, b2) : BodyPair(b2, b1);
+}
+
+static int Fail(const char* check, const char* what)
+{
+	printf("%-10s %s\n", check, what);
+	return 1;
+}
+
+// Applies the begins minus the ends of each pair to the open pairs. One
+// call can take several steps, so a pair may begin and end, or end and
+// begin, within it; it may not begin twice or end twice.
+static int Replay(const std::map<BodyPair, int>& net, std::set<BodyPair>* open, const char* check, const char* what)
+{
+	int failures = 0;
+	for (std::map<BodyPair, int>::const_iterator i = net.begin(); i != net.end(); ++i)
+	{
+		bool wasOpen = open->count(i->first) > 0;
+		if (i->second > 1 || i->second < -1 || (wasOpen && i->second > 0) || (!wasOpen && i->second < 0))
+			failures += Fail(check, what);
+		else if (i->second > 0)
+			open->insert(i->first);
+		else if (i->second < 0)
+			open->erase(i->first);
+	}
+	return failures;
+}
+
+// Replays the begin and end events of each Step or Advance onto the pairs
+// it has seen begin, and expects to end up with the pairs the world holds.
+struct EventLedger
+{
+	EventLedger() : begins(0), ends(0), sensorBegins(0), sensorEnds(0) {}
+
+	int Read(const World& world, const char* check)
+	{
+		int failures = 0;
+
+		std::map<BodyPair, int> net;
+		for (int i = 0; i < (int)world.contactBeginEvents.size(); ++i)
+			++net[MakePair(world.contactBeginEvents[i].body1, world.contactBeginEvents[i].body2)];
+		for (int i = 0; i < (int)world.contactEndEvents.size(); ++i)
+			--net[MakePair(world.contactEndEvents[i].body1, world.contactEndEvents[i].body2)];
+		begins += (int)world.contactBeginEvents.size();
+		ends += (int)world.contactEndEvents.size();
+		failures += Replay(net, &contacts, check, "contact events do not pair up");
+
+		std::set<BodyPair> touching;
+		for (std::map<ArbiterKey, Arbiter>::const_iterator arb = world.arbiters.begin(); arb != world.arbiters.end(); ++arb)
+			touching.insert(MakePair(arb->first.body1, arb->first.body2));
+		if (touching != contacts)
+			failures += Fail(check, "contact events disagree with the arbiters");
+
+		net.clear();
+		for (int i = 0; i < (int)world.sensorBeginEvents.size(); ++i)
+			++net[MakePair(world.sensorBeginEvents[i].sensor, world.sensorBeginEvents[i].visitor)];
+		for (int i = 0; i < (int)world.sensorEndEvents.size(); ++i)
+			--net[MakePair(world.sensorEndEvents[i].sensor, world.sensorEndEvents[i].visitor)];
+		sensorBegins += (int)world.sensorBeginEvents.size();
+		sensorEnds += (int)world.sensorEndEvents.size();
+		failures += Replay(net, &sensors, check, "sensor events do not pair up");
+
+		std::set<BodyPair> overlapping;
+		for (std::set<ArbiterKey>::const_iterator sensor = world.sensorPairs.begin(); sensor != world.sensorPairs.end(); ++sensor)
+			overlapping.insert(MakePair(sensor->body1, sensor->body2));
+		if (overlapping != sensors)
+			failures += Fail(check, "sensor events disagree with the sensor pairs");
+
+		return failures;
+	}
+
+	bool Overlapping(Body* b1, Body* b2) const
+	{
+		return sensors.count(MakePair(b1, b2)) > 0;
+	}
+
+	std::set<BodyPair> contacts;
+	std::set<BodyPair> sensors;
+	int begins, ends;
+	int sensorBegins, sensorEnds;
+};
+
+// Boxes dropped into a bin, driven by Advance with uneven frame times and
+// thinned out by removals on the way. Frames that take no step must leave
+// no events, and frames that take several must keep them all.
+static int CheckContactEvents()
+{
+	const char* check = "events";
+	int failures = 0;
+
+	World world(gravity, 10);
+	world.fixedTimeStep = timeStep;
+	world.maxFixedSteps = 4;
+
+	SceneBuilder scene(&world);
+	scene.AddGround();
+	scene.AddBox(Vec2(-6.0f, 10.0f), Vec2(1.0f, 20.0f), FLT_MAX);
+	scene.AddBox(Vec2(6.0f, 10.0f), Vec2(1.0f, 20.0f), FLT_MAX);
+	scene.RandomPile(120, Vec2(0.0f, 1.0f), 10.0f, 0.4f, 1.0f, 1.0f);
+
+	EventLedger ledger;
+	const float frames[] = {0.0f, 2.5f, 0.4f, 0.3f, 1.0f, 3.7f, 0.0f, 0.9f};
+	int frameCount = (int)(sizeof(frames) / sizeof(frames[0]));
+
+	for (int i = 0; i < 600; ++i)
+	{
+		// Every few frames a box goes, some while touching others.
+		if (i % 7 == 3)
+			world.Remove(&scene.bodies[3 + (i * 13) % (int)(scene.bodies.size() - 3)]);
+
+		int steps = world.Advance(frames[i % frameCount] * timeStep);
+		if (steps == 0 && (!world.contactBeginEvents.empty() || !world.contactEndEvents.empty()))
+			failures += Fail(check, "a frame without steps reported events");
+
+		failures += ledger.Read(world, check);
+	}
+
+	if (ledger.begins == 0 || ledger.ends == 0)
+		failures += Fail(check, "the scene made no begin or no end events");
+
+	printf("%-10s %d begins, %d ends, %d failures\n", check, ledger.begins, ledger.ends, failures);
+	return failures;
+}
+
+// A kinematic box slides through a static trigger, a dynamic box falls
+// through a dynamic sensor that then stops seeing it by filter, and a
+// sensor follows a box that is removed while inside it.
+static int CheckSensorEvents()
+{
+	const char* check = "sensors";
+	int failures = 0;
+
+	World world(gravity, 10);
+	world.fixedTimeStep = timeStep;
+	world.maxFixedSteps = 4;
+
+	SceneBuilder scene(&world);
+	scene.AddGround();
+
+	Body* trigger = scene.AddBox(Vec2(0.0f, 1.5f), Vec2(2.0f, 2.0f), FLT_MAX);
+	trigger->isSensor = true;
+	Body* slider = scene.AddBox(Vec2(-8.0f, 1.5f), Vec2(1.0f, 1.0f), 1.0f);
+	slider->SetType(KINEMATIC_BODY);
+	slider->velocity.Set(4.0f, 0.0f);
+
+	Body* field = scene.AddBox(Vec2(8.0f, 2.0f), Vec2(3.0f, 4.0f), 1.0f);
+	field->isSensor = true;
+	field->SetType(KINEMATIC_BODY);
+	Body* faller = scene.AddBox(Vec2(8.0f, 8.0f), Vec2(0.5f, 0.5f), 1.0f);
+
+	Body* ring = scene.AddBox(Vec2(-8.0f, 6.0f), Vec2(3.0f, 3.0f), FLT_MAX);
+	ring->isSensor = true;
+	Body* doomed = scene.AddBox(Vec2(-8.0f, 6.0f), Vec2(0.5f, 0.5f), 1.0f);
+	doomed->SetType(KINEMATIC_BODY);
+
+	EventLedger ledger;
+	bool sliderEntered = false, fallerEntered = false, doomedEntered = false;
+	const float frames[] = {1.0f, 0.0f, 2.5f, 0.5f};
+	int frameCount = (int)(sizeof(frames) / sizeof(frames[0]));
+
+	for (int i = 0; i < 240; ++i)
+	{
+		if (i == 120)
+		{
+			// Only the sensor pair is filtered; the box stays on the ground.
+			faller->groupIndex = -1;
+			field->groupIndex = -1;
+			world.Remove(doomed);
+		}
+
+		world.Advance(frames[i % frameCount] * timeStep);
+		failures += ledger.Read(world, check);
+
+		sliderEntered = sliderEntered || ledger.Overlapping(trigger, slider);
+		fallerEntered = fallerEntered || ledger.Overlapping(field, faller);
+		doomedEntered = doomedEntered || ledger.Overlapping(ring, doomed);
+	}
+
+	if (!sliderEntered || ledger.Overlapping(trigger, slider))
+		failures += Fail(check, "a kinematic body did not pass through a static trigger");
+	if (!fallerEntered || ledger.Overlapping(field, faller))
+		failures += Fail(check, "a filtered pair did not end its overlap");
+	if (!doomedEntered || ledger.Overlapping(ring, doomed))
+		failures += Fail(check, "a removed body did not end its overlap");
+
+	printf("%-10s %d begins, %d ends, %d failures\n", check, ledger.sensorBegins, ledger.sensorEnds, failures);
+	return failures;
+}
+
+// Nothing in the world may refer to a body after its removal is applied.
+static int CheckRemovedBodies(const World& world, const SceneBuilder& scene, const char* check)
+{
+	int failures = 0;
+	for (std::deque<Body>::const_iterator b = scene.bodies.begin(); b != scene.bodies.end(); ++b)
+	{
+		if (b->proxyId != DynamicTree::NULL_NODE)
+			continue;
+
+		for (int i = 0; i < (int)b->boxes.size(); ++i)
+		{
+			if (b->boxes[i].proxyId != DynamicTree::NULL_NODE)
+				failures += Fail(check, "a removed compound kept a box proxy");
+		}
+		if (std::find(world.bodies.begin(), world.bodies.end(), &*b) != world.bodies.end())
+			failures += Fail(check, "a removed body is still in the world");
+	}
+
+	for (std::map<ArbiterKey, Arbiter>::const_iterator arb = world.arbiters.begin(); arb != world.arbiters.end(); ++arb)
+	{
+		if (arb->first.body1->proxyId == DynamicTree::NULL_NODE || arb->first.body2->proxyId == DynamicTree::NULL_NODE)
+			failures += Fail(check, "an arbiter outlived its body");
+	}
+	for (std::map<ArbiterKey, SeparatedPair>::const_iterator sep = world.separatedPairs.begin(); sep != world.separatedPairs.end(); ++sep)
+	{
+		if (sep->first.body1->proxyId == DynamicTree::NULL_NODE || sep->first.body2->proxyId == DynamicTree::NULL_NODE)
+			failures += Fail(check, "a separated pair outlived its body");
+	}
+	for (std::set<ArbiterKey>::const_iterator sensor = world.sensorPairs.begin(); sensor != world.sensorPairs.end(); ++sensor)
+	{
+		if (sensor->body1->proxyId == DynamicTree::NULL_NODE || sensor->body2->proxyId == DynamicTree::NULL_NODE)
+			failures += Fail(check, "a sensor pair outlived its body");
+	}
+	for (int i = 0; i < (int)world.joints.size(); ++i)
+	{
+		if (world.joints[i]->body1->proxyId == DynamicTree::NULL_NODE || world.joints[i]->body2->proxyId == DynamicTree::NULL_NODE)
+			failures += Fail(check, "a joint outlived its body");
+	}
+
+	return failures;
+}
+
+// Removal churn: half of a busy scene goes in one batch, with bodies
+// queued twice, a compound, a jointed chain and a body inside a sensor
+// among them. Then everything goes, including bodies already removed, and
+// the world must be empty. Last, removed bodies are added back.
+static int CheckRemovals()
+{
+	const char* check = "removals";
+	int failures = 0;
+
+	World world(gravity, 10);
+	world.fixedTimeStep = timeStep;
+
+	SceneBuilder scene(&world);
+	Body* ground = scene.AddGround();
+	scene.RandomPile(80, Vec2(0.0f, 1.0f), 10.0f, 0.4f, 1.0f, 1.0f);
+
+	BoxShape boxes[2] = {BoxShape(Vec2(3.0f, 0.5f), Vec2(0.0f, 0.0f)), BoxShape(Vec2(0.5f, 2.0f), Vec2(-1.25f, 1.25f))};
+	Body* compound = scene.AddCompound(Vec2(-10.0f, 0.25f), boxes, 2, 3.0f);
+
+	Body* post = scene.AddBox(Vec2(10.0f, 4.0f), Vec2(0.5f, 8.0f), FLT_MAX);
+	scene.Chain(post, Vec2(10.25f, 7.5f), 6, Vec2(0.75f, 0.2f), 1.0f);
+
+	Body* sensor = scene.AddBox(Vec2(-10.0f, 1.0f), Vec2(4.0f, 2.0f), FLT_MAX);
+	sensor->isSensor = true;
+
+	EventLedger ledger;
+	for (int i = 0; i < 60; ++i)
+	{
+		world.Step(timeStep);
+		failures += ledger.Read(world, check);
+	}
+
+	if (!ledger.Overlapping(sensor, compound))
+		failures += Fail(check, "the compound did not enter the sensor");
+
+	// Every other body, some of them twice
+	int count = (int)scene.bodies.size();
+	for (int i = 1; i < count; i += 2)
+	{
+		world.Remove(&scene.bodies[i]);
+		if (i % 3 == 0)
+			world.Remove(&scene.bodies[i]);
+	}
+	world.Remove(compound);
+	world.Remove(compound);
+	world.Remove(&scene.bodies[scene.bodies.size() - 3]);
+
+	for (int i = 0; i < 30; ++i)
+	{
+		world.Step(timeStep);
+		failures += ledger.Read(world, check);
+		failures += CheckRemovedBodies(world, scene, check);
+	}
+
+	for (int i = 0; i < count; ++i)
+		world.Remove(&scene.bodies[i]);
+	world.Step(timeStep);
+	failures += ledger.Read(world, check);
+	failures += CheckRemovedBodies(world, scene, check);
+
+	if (!world.bodies.empty() || !world.joints.empty())
+		failures += Fail(check, "bodies or joints are left");
+	if (!world.arbiters.empty() || !world.separatedPairs.empty() || !world.sensorPairs.empty())
+		failures += Fail(check, "pairs are left");
+	if (world.tree.root != DynamicTree::NULL_NODE)
+		failures += Fail(check, "proxies are left");
+	if (!ledger.contacts.empty() || !ledger.sensors.empty())
+		failures += Fail(check, "a pair began but never ended");
+
+	// Removed bodies may come back.
+	world.Add(ground);
+	world.Add(compound);
+	world.Add(sensor);
+	for (int i = 0; i < 60; ++i)
+	{
+		world.Step(timeStep);
+		failures += ledger.Read(world, check);
+	}
+
+	if (world.arbiters.size() != 1 || !ledger.Overlapping(sensor, compound))
+		failures += Fail(check, "bodies added back do not collide");
+
+	printf("%-10s %d contact and %d sensor ends, %d failures\n", check, ledger.ends, ledger.sensorEnds, failures);
+	return failures;
+}
+
+// An L resting on the ground with the foot and the upright both touching
+// it. The merged arbiter must keep all four points, two per box, and the
+// body must settle without rocking, with each solver.
+static int CheckRestingCompound()
+{
+	const char* check = "compound";
+	int failures = 0;
+
+	for (int solver = 0; solver < 3; ++solver)
+	{
+		World::blockSolver = solver == 1;
+		World::splitImpulse = solver == 2;
+
+		World world(gravity, 10);
+		SceneBuilder scene(&world);
+		scene.AddGround();
+
+		BoxShape boxes[2] = {BoxShape(Vec2(3.0f, 0.5f), Vec2(0.0f, 0.25f)), BoxShape(Vec2(0.5f, 2.0f), Vec2(-1.25f, 1.0f))};
+		Body* l = scene.AddCompound(Vec2(0.0f, 0.0f), boxes, 2, 3.0f);
+
+		bool lostPoints = false;
+		float maxAngularSpeed = 0.0f;
+		float settled = 0.0f;
+		for (int i = 0; i < 600; ++i)
+		{
+			world.Step(timeStep);
+
+			// Let it settle into the ground first.
+			if (i < 60)
+			{
+				settled = l->rotation;
+				continue;
+			}
+
+			lostPoints = lostPoints || world.arbiters.size() != 1 || world.arbiters.begin()->second.numContacts != 4;
+			maxAngularSpeed = Max(maxAngularSpeed, Abs(l->angularVelocity));
+		}
+
+		if (lostPoints)
+			failures += Fail(check, "the resting L did not keep four contact points");
+		if (maxAngularSpeed > 1.0e-3f || Abs(l->rotation - settled) > 1.0e-3f)
+			failures += Fail(check, "the resting L wobbles");
+	}
+
+	World::blockSolver = false;
+	World::splitImpulse = false;
+
+	printf("%-10s %d failures\n", check, failures);
+	return failures;
+}
+
+// A heavy box shoves a small one into the corner of a tile floor and wall.
+// The small box's floor contact reaches under the wall and its wall
+// contact may flip onto the wall's bottom face; if both are taken for
+// ghosts, the box loses its support and falls out of the level.
+static int CheckTileCorner()
+{
+	const char* check = "tiles";
+	int failures = 0;
+
+	for (int solver = 0; solver < 2; ++solver)
+	{
+		World::splitImpulse = solver == 1;
+
+		World world(gravity, 10);
+		TileMap& tiles = world.tiles;
+		tiles.Set(16, 8, Vec2(0.5f, 0.5f), Vec2(-2.0f, -1.0f));
+		for (int x = 0; x < tiles.width; ++x)
+		{
+			for (int y = 0; y < (x < 2 ? tiles.height : 2); ++y)
+				tiles.SetSolid(x, y, true);
+		}
+
+		// The floor is at y = 0 and the wall face at x = -1.
+		SceneBuilder scene(&world);
+		Body* box = scene.AddBox(Vec2(-0.8f, 0.15f), Vec2(0.3f, 0.3f), 0.2f, 0.3f);
+		Body* pusher = scene.AddBox(Vec2(0.0f, 0.6f), Vec2(1.2f, 1.2f), 100.0f);
+		box->isBreakAble = false;
+		pusher->isBreakAble = false;
+
+		bool escaped = false;
+		for (int i = 0; i < 600; ++i)
+		{
+			pusher->AddForce(Vec2(-1500.0f, 0.0f));
+			world.Step(timeStep);
+			escaped = escaped || box->position.y < -0.15f || box->position.x < -1.5f;
+		}
+
+		if (escaped || box->velocity.Length() > 0.1f)
+			failures += Fail(check, "a box in a corner was pushed out of the level");
+	}
+
+	World::splitImpulse = false;
+
+	printf("%-10s %d failures\n", check, failures);
+	return failures;
+}
+
+int RunChecks()
+{
+	World::manifoldCaching = true;
+
+	int failures = 0;
+	failures += CheckContactEvents();
+	failures += CheckSensorEvents();
+	failures += CheckRemovals();
+	failures += CheckRestingCompound();
+	failures += CheckTileCorner();
+	return failures;
+}
@@ -0,0 +1,19 @@
+/*
+* Copyright (c) 2006-2009 Erin Catto http://www.gphysics.com
+*
+* Permission to use, copy, modify, distribute and sell this software
+* and its documentation for any purpose is hereby granted without fee,
+* provided that the above copyright notice appear in all copies.
+* Erin Catto makes no representations about the suitability
+* of this software for any purpose.
+* It is provided "as is" without express or implied warranty.
+*/
+
+#ifndef CHECKS_H
+#define CHECKS_H
+
+// Behaviour the counters cannot see, run by benchmark --checks. Prints
+// each failure and returns how many there were.
+int RunChecks();
+
+#endif
@@ -0,0 +1,588 @@
+/*
+* Copyright (c) 2006-2007 Erin Catto http://www.gphysics.com
+*
+* Permission to use, copy, modify, distribute and sell this software
+* and its documentation for any purpose is hereby granted without fee,
+* provided that the above copyright notice appear in all copies.
+* Erin Catto makes no representations about the suitability 
+* of this software for any purpose.  
+* It is provided "as is" without express or implied warranty.
+*/
+
+// Headless benchmark. Runs the stacking scenes with several solver settings
+// and reports the cost per step together with how well the stack held up.
+//
+// It doubles as a regression check against a stored baseline:
+//   benchmark [--repeat N] [--steps N] [--scene NAME] [--write FILE] [--baseline FILE] [--threshold PERCENT] [--check-time]
+// Each configuration runs N times. The time per step is summarized by its
+// median and median absolute deviation (MAD), so one noisy run does not
+// move the result. --write stores the results as JSON. --baseline compares
+// with such a file and exits with 1 if any configuration regressed. Only
+// the counters (passes, pairs, contacts) are compared unless --check-time
+// is given: timings only mean something on the machine that recorded the
+// baseline.
+//
+//   benchmark --checks
+// runs the behaviour checks in checks.cpp instead and exits with 1 if any
+// failed.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <chrono>
+
+#include "box2d-lite/World.h"
+#include "box2d-lite/Body.h"
+#include "box2d-lite/SceneBuilder.h"
+#include "checks.h"
+
+namespace
+{
+	float timeStep = 1.0f / 60.0f;
+	int stepCount = 600;
+	Vec2 gravity(0.0f, -10.0f);
+
+	// Scale from MAD to the standard deviation of a normal distribution
+	const double k_madScale = 1.4826;
+}
+
+struct Settings
+{
+	const char* name;
+	bool softStep;
+	bool blockSolver;
+	bool splitImpulse;
+	int iterations;
+	int maxIterations;
+	float tolerance;
+	int subSteps;
+};
+
+// A tall vertical stack
+static void Stack(SceneBuilder& scene)
+{
+	scene.AddGround();
+
+	for (int i = 0; i < 20; ++i)
+	{
+		scene.AddBox(Vec2(0.0f, 0.51f + 1.05f * i), Vec2(1.0f, 1.0f), 1.0f);
+	}
+}
+
+// A tightly packed pyramid
+static void Pyramid(SceneBuilder& scene)
+{
+	scene.AddGround();
+	scene.Pyramid(20, Vec2(-0.5625f, 0.0f), Vec2(1.0f, 1.0f), 10.0f);
+}
+
+// A brick wall
+static void Wall(SceneBuilder& scene)
+{
+	scene.AddGround();
+	scene.Wall(20, 15, Vec2(0.0f, 0.0f), Vec2(1.0f, 0.5f), 5.0f);
+}
+
+// Random boxes dropped into a bin
+static void Pile(SceneBuilder& scene)
+{
+	scene.AddGround();
+	scene.AddBox(Vec2(-11.0f, 20.0f), Vec2(1.0f, 40.0f), FLT_MAX);
+	scene.AddBox(Vec2(11.0f, 20.0f), Vec2(1.0f, 40.0f), FLT_MAX);
+	scene.RandomPile(400, Vec2(0.0f, 1.0f), 20.0f, 0.3f, 1.2f, 2.0f);
+}
+
+// Random boxes dropped into a bin of tiles with a stepped floor. The tile
+// bodies never enter the broadphase.
+static void Tiles(SceneBuilder& scene)
+{
+	TileMap& tiles = scene.world->tiles;
+	tiles.Set(48, 80, Vec2(0.5f, 0.5f), Vec2(-12.0f, -1.0f));
+	for (int x = 0; x < tiles.width; ++x)
+	{
+		int top = (x < 2 || x >= tiles.width - 2) ? tiles.height : 2 + (x / 6) % 3;
+		for (int y = 0; y < top; ++y)
+			tiles.SetSolid(x, y, true);
+	}
+
+	scene.RandomPile(400, Vec2(0.0f, 2.0f), 20.0f, 0.3f, 1.2f, 2.0f);
+}
+
+// L, T and U shaped compounds dropped into a bin
+static void Compounds(SceneBuilder& scene)
+{
+	scene.AddGround();
+	scene.AddBox(Vec2(-11.0f, 40.0f), Vec2(1.0f, 80.0f), FLT_MAX);
+	scene.AddBox(Vec2(11.0f, 40.0f), Vec2(1.0f, 80.0f), FLT_MAX);
+
+	BoxShape l[2] = {BoxShape(Vec2(2.0f, 0.5f), Vec2(0.0f, 0.0f)), BoxShape(Vec2(0.5f, 1.5f), Vec2(-0.75f, 0.5f))};
+	BoxShape t[2] = {BoxShape(Vec2(2.0f, 0.5f), Vec2(0.0f, 0.75f)), BoxShape(Vec2(0.5f, 1.5f), Vec2(0.0f, 0.0f))};
+	BoxShape u[3] = {BoxShape(Vec2(2.0f, 0.5f), Vec2(0.0f, -0.5f)), BoxShape(Vec2(0.5f, 1.5f), Vec2(-0.75f, 0.0f)), BoxShape(Vec2(0.5f, 1.5f), Vec2(0.75f, 0.0f))};
+
+	// Cells of 3 fit any of them at any rotation.
+	for (int i = 0; i < 90; ++i)
+	{
+		Vec2 p(-7.5f + 3.0f * (i % 6), 2.0f + 3.0f * (i / 6));
+		float rotation = scene.random.Next(-k_pi, k_pi);
+		if (i % 3 == 0)
+			scene.AddCompound(p, l, 2, 2.0f, rotation);
+		else if (i % 3 == 1)
+			scene.AddCompound(p, t, 2, 2.0f, rotation);
+		else
+			scene.AddCompound(p, u, 3, 2.5f, rotation);
+	}
+}
+
+// Dominoes, a hanging chain and ragdolls under steady rain
+static RainEmitter rain;
+
+static void Builder(SceneBuilder& scene)
+{
+	scene.AddGround();
+	scene.Dominoes(20, Vec2(-15.0f, 0.0f), 0.8f, Vec2(0.15f, 1.5f), 5.0f);
+
+	Body* post = scene.AddBox(Vec2(6.0f, 6.0f), Vec2(0.5f, 12.0f), FLT_MAX);
+	scene.Chain(post, Vec2(6.25f, 11.5f), 12, Vec2(0.75f, 0.2f), 2.0f);
+
+	scene.Ragdolls(16, Vec2(-2.0f, 0.0f), 2.5f, 1.0f, 20.0f);
+
+	rain = RainEmitter();
+	rain.rate = 30.0f;
+	rain.xMin = -15.0f;
+	rain.xMax = 15.0f;
+	rain.y = 20.0f;
+	rain.minSize = 0.3f;
+	rain.maxSize = 0.6f;
+	rain.maxBodies = (int)scene.bodies.size() + 200;
+}
+
+static void BuilderUpdate(SceneBuilder& scene, float dt)
+{
+	rain.Update(scene, dt);
+}
+
+struct Scene
+{
+	const char* name;
+	void (*create)(SceneBuilder& scene);
+	void (*update)(SceneBuilder& scene, float dt);	// before each step, may be NULL
+};
+
+// One configuration's numbers. Time is wall clock and varies from run to
+// run; the counters are deterministic for a given build.
+struct Result
+{
+	Result() : nsMedian(0.0), nsMad(0.0), passes(0.0), pairs(0.0), contacts(0.0), drift(0.0f), speed(0.0f), hitRate(0.0f), collide(0.0f) {}
+
+	std::string scene;
+	std::string solver;
+	double nsMedian;
+	double nsMad;
+	double passes;		// velocity passes per step
+	double pairs;		// broadphase pairs per step
+	double contacts;	// contact points per step
+	float drift;
+	float speed;
+	float hitRate;
+	float collide;
+};
+
+static double Median(std::vector<double> values)
+{
+	std::sort(values.begin(), values.end());
+	int n = (int)values.size();
+	if (n == 0)
+		return 0.0;
+	return (n & 1) ? values[n / 2] : 0.5 * (values[n / 2 - 1] + values[n / 2]);
+}
+
+static double MedianAbsoluteDeviation(const std::vector<double>& values, double median)
+{
+	std::vector<double> deviations;
+	for (int i = 0; i < (int)values.size(); ++i)
+		deviations.push_back(fabs(values[i] - median));
+	return Median(deviations);
+}
+
+// Steps a fresh copy of the scene and fills everything but the timing
+// summary. Returns the nanoseconds spent in World::Step per step.
+static double Run(const Scene& scene, const Settings& settings, Result* result)
+{
+	World::softStep = settings.softStep;
+	World::blockSolver = settings.blockSolver;
+	World::splitImpulse = settings.splitImpulse;
+	World::manifoldCaching = true;
+
+	World world(gravity, settings.iterations);
+	world.maxIterations = settings.maxIterations;
+	world.convergenceTolerance = settings.tolerance;
+	world.subSteps = settings.subSteps;
+
+	SceneBuilder builder(&world);
+	scene.create(builder);
+
+	// Measure the solver, not breakage.
+	for (int i = 0; i < (int)builder.bodies.size(); ++i)
+		builder.bodies[i].isBreakAble = false;
+
+	std::vector<Vec2> start;
+	for (int i = 0; i < (int)builder.bodies.size(); ++i)
+		start.push_back(builder.bodies[i].position);
+
+	long long ns = 0;
+	int passes = 0;
+	int pairs = 0;
+	int contacts = 0;
+	int cacheHits = 0, cacheMisses = 0;
+	int narrowphaseCalls = 0;
+	for (int i = 0; i < stepCount; ++i)
+	{
+		if (scene.update != NULL)
+			scene.update(builder, timeStep);
+
+		std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+		world.Step(timeStep);
+		std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+		ns += std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0).count();
+
+		passes += world.profile.iterations + world.profile.extraIterations + world.profile.positionIterations;
+		pairs += world.profile.broadphasePairs;
+		cacheHits += world.profile.manifoldCacheHits;
+		cacheMisses += world.profile.manifoldCacheMisses;
+		narrowphaseCalls += world.profile.narrowphaseCalls;
+
+		for (std::map<ArbiterKey, Arbiter>::const_iterator arb = world.arbiters.begin(); arb != world.arbiters.end(); ++arb)
+			contacts += arb->second.numContacts;
+	}
+
+	// Stacking quality: how far the boxes have drifted and how much they
+	// still move. Bodies the scene added while running are not measured.
+	float maxDrift = 0.0f;
+	float maxSpeed = 0.0f;
+	for (int i = 0; i < (int)start.size(); ++i)
+	{
+		Body* b = &builder.bodies[i];
+		if (b->type != DYNAMIC_BODY)
+			continue;
+
+		maxDrift = Max(maxDrift, (b->position - start[i]).Length());
+		maxSpeed = Max(maxSpeed, b->velocity.Length());
+	}
+
+	result->scene = scene.name;
+	result->solver = settings.name;
+	result->passes = (double)passes / stepCount;
+	result->pairs = (double)pairs / stepCount;
+	result->contacts = (double)contacts / stepCount;
+	result->drift = maxDrift;
+	result->speed = maxSpeed;
+	result->hitRate = cacheHits + cacheMisses > 0 ? 100.0f * cacheHits / (cacheHits + cacheMisses) : 0.0f;
+	result->collide = (float)narrowphaseCalls / stepCount;
+
+	return (double)ns / stepCount;
+}
+
+static bool WriteResults(const char* path, const std::vector<Result>& results)
+{
+	FILE* file = fopen(path, "w");
+	if (file == NULL)
+	{
+		printf("cannot write %s\n", path);
+		return false;
+	}
+
+	// One object per line keeps the file easy to diff and to read back.
+	fprintf(file, "{\n\"steps\": %d,\n\"results\": [\n", stepCount);
+	for (int i = 0; i < (int)results.size(); ++i)
+	{
+		const Result& r = results[i];
+		fprintf(file, "{\"scene\": \"%s\", \"solver\": \"%s\", \"ns_median\": %.0f, \"ns_mad\": %.0f, \"passes\": %.3f, \"pairs\": %.3f, \"contacts\": %.3f, \"drift\": %.4f, \"speed\": %.4f}%s\n",
+			r.scene.c_str(), r.solver.c_str(), r.nsMedian, r.nsMad, r.passes, r.pairs, r.contacts, r.drift, r.speed, i + 1 < (int)results.size() ? "," : "");
+	}
+	fprintf(file, "]\n}\n");
+	fclose(file);
+	return true;
+}
+
+static bool ReadString(const char* line, const char* key, std::string* value)
+{
+	char pattern[64];
+	sprintf(pattern, "\"%s\": \"", key);
+	const char* p = strstr(line, pattern);
+	if (p == NULL)
+		return false;
+	p += strlen(pattern);
+	const char* end = strchr(p, '"');
+	if (end == NULL)
+		return false;
+	value->assign(p, end);
+	return true;
+}
+
+static bool ReadNumber(const char* line, const char* key, double* value)
+{
+	char pattern[64];
+	sprintf(pattern, "\"%s\": ", key);
+	const char* p = strstr(line, pattern);
+	if (p == NULL)
+		return false;
+	*value = atof(p + strlen(pattern));
+	return true;
+}
+
+// Reads a file written by WriteResults.
+static bool ReadResults(const char* path, std::vector<Result>* results, int* steps)
+{
+	FILE* file = fopen(path, "r");
+	if (file == NULL)
+	{
+		printf("cannot read %s\n", path);
+		return false;
+	}
+
+	char line[1024];
+	while (fgets(line, sizeof(line), file))
+	{
+		double value;
+		if (ReadNumber(line, "steps", &value))
+			*steps = (int)value;
+
+		Result r;
+		if (!ReadString(line, "scene", &r.scene) || !ReadString(line, "solver", &r.solver))
+			continue;
+
+		ReadNumber(line, "ns_median", &r.nsMedian);
+		ReadNumber(line, "ns_mad", &r.nsMad);
+		ReadNumber(line, "passes", &r.passes);
+		ReadNumber(line, "pairs", &r.pairs);
+		ReadNumber(line, "contacts", &r.contacts);
+
+		// Older files have no quality numbers; -1 skips the check.
+		double drift = -1.0, speed = -1.0;
+		ReadNumber(line, "drift", &drift);
+		ReadNumber(line, "speed", &speed);
+		r.drift = (float)drift;
+		r.speed = (float)speed;
+		results->push_back(r);
+	}
+
+	fclose(file);
+	return true;
+}
+
+// Counters should match within a small relative tolerance. Different
+// compilers round differently, so they are not required to match exactly.
+static bool CounterRegressed(double current, double baseline, double threshold)
+{
+	return current > baseline * (1.0 + threshold) + 1.0e-3;
+}
+
+// Drift and speed follow the solver's rounding more closely than the
+// counters do, so they get 25% plus 5 cm (or 5 cm/s) of room. That still
+// catches a body falling through the world. NaN always regresses.
+static bool QualityRegressed(float current, float baseline)
+{
+	if (baseline < 0.0f)
+		return false;
+	return !(current <= 1.25f * baseline + 0.05f);
+}
+
+// Time regresses when the medians differ by more than the threshold and by
+// more than three standard deviations of the difference, estimated from
+// the MADs of both sides.
+static bool TimeRegressed(const Result& current, const Result& baseline, double threshold, double* sigmas)
+{
+	double difference = current.nsMedian - baseline.nsMedian;
+	double sigma = k_madScale * sqrt(current.nsMad * current.nsMad + baseline.nsMad * baseline.nsMad);
+	*sigmas = sigma > 0.0 ? difference / sigma : 0.0;
+
+	return difference > threshold * baseline.nsMedian && difference > 3.0 * sigma;
+}
+
+static int Compare(const std::vector<Result>& results, const std::vector<Result>& baseline, double threshold, bool checkTime)
+{
+	int regressions = 0;
+	int missing = 0;
+
+	for (int i = 0; i < (int)results.size(); ++i)
+	{
+		const Result& r = results[i];
+
+		const Result* b = NULL;
+		for (int j = 0; j < (int)baseline.size(); ++j)
+		{
+			if (baseline[j].scene == r.scene && baseline[j].solver == r.solver)
+			{
+				b = &baseline[j];
+				break;
+			}
+		}
+
+		if (b == NULL)
+		{
+			printf("%-10s %-22s not in the baseline\n", r.scene.c_str(), r.solver.c_str());
+			++missing;
+			continue;
+		}
+
+		// A counter threshold of 2% allows for compiler rounding, not for
+		// a change in the algorithm.
+		double sigmas = 0.0;
+		bool time = checkTime && TimeRegressed(r, *b, threshold, &sigmas);
+		bool passes = CounterRegressed(r.passes, b->passes, 0.02);
+		bool pairs = CounterRegressed(r.pairs, b->pairs, 0.02);
+		bool contacts = CounterRegressed(r.contacts, b->contacts, 0.02);
+		bool drift = QualityRegressed(r.drift, b->drift);
+		bool speed = QualityRegressed(r.speed, b->speed);
+
+		if (!time && !passes && !pairs && !contacts && !drift && !speed)
+			continue;
+
+		printf("%-10s %-22s regressed\n", r.scene.c_str(), r.solver.c_str());
+		if (time)
+			printf("    ns/step %.0f -> %.0f (+%.1f%%, %.1f sigma)\n", b->nsMedian, r.nsMedian, 100.0 * (r.nsMedian - b->nsMedian) / b->nsMedian, sigmas);
+		if (passes)
+			printf("    passes %.3f -> %.3f\n", b->passes, r.passes);
+		if (pairs)
+			printf("    pairs %.3f -> %.3f\n", b->pairs, r.pairs);
+		if (contacts)
+			printf("    contacts %.3f -> %.3f\n", b->contacts, r.contacts);
+		if (drift)
+			printf("    drift %.4f -> %.4f\n", b->drift, r.drift);
+		if (speed)
+			printf("    speed %.4f -> %.4f\n", b->speed, r.speed);
+
+		++regressions;
+	}
+
+	printf("%d of %d configurations regressed, %d not in the baseline\n", regressions, (int)results.size(), missing);
+	return regressions;
+}
+
+int main(int argc, char** argv)
+{
+	int repeat = 1;
+	double threshold = 0.15;
+	const char* sceneName = NULL;
+	const char* writePath = NULL;
+	const char* baselinePath = NULL;
+	bool checkTime = false;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		bool hasValue = i + 1 < argc;
+		if (strcmp(argv[i], "--repeat") == 0 && hasValue)
+			repeat = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--steps") == 0 && hasValue)
+			stepCount = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--scene") == 0 && hasValue)
+			sceneName = argv[++i];
+		else if (strcmp(argv[i], "--write") == 0 && hasValue)
+			writePath = argv[++i];
+		else if (strcmp(argv[i], "--baseline") == 0 && hasValue)
+			baselinePath = argv[++i];
+		else if (strcmp(argv[i], "--threshold") == 0 && hasValue)
+			threshold = 0.01 * atof(argv[++i]);
+		else if (strcmp(argv[i], "--check-time") == 0)
+			checkTime = true;
+		else if (strcmp(argv[i], "--checks") == 0)
+			return RunChecks() > 0 ? 1 : 0;
+	}
+
+	if (repeat < 1)
+		repeat = 1;
+	if (stepCount < 1)
+		stepCount = 1;
+
+	std::vector<Result> baseline;
+	if (baselinePath != NULL)
+	{
+		int baselineSteps = stepCount;
+		if (!ReadResults(baselinePath, &baseline, &baselineSteps))
+			return 1;
+
+		// Counters per step depend on how long the scene ran.
+		if (baselineSteps != stepCount)
+		{
+			printf("the baseline was recorded with %d steps, not %d\n", baselineSteps, stepCount);
+			return 1;
+		}
+	}
+
+	Scene scenes[] = {
+		{"stack", Stack},
+		{"pyramid", Pyramid},
+		{"wall", Wall},
+		{"pile", Pile},
+		{"tiles", Tiles},
+		{"compounds", Compounds},
+		{"builder", Builder, BuilderUpdate}};
+
+	Settings settings[] = {
+		{"baumgarte 10 iters", false, false, false, 10, 10, 0.0f, 1},
+		{"baumgarte 20 iters", false, false, false, 20, 20, 0.0f, 1},
+		{"baumgarte 40 iters", false, false, false, 40, 40, 0.0f, 1},
+		{"block 5 iters", false, true, false, 5, 5, 0.0f, 1},
+		{"block 10 iters", false, true, false, 10, 10, 0.0f, 1},
+		{"block adaptive 10/20", false, true, false, 10, 20, 0.001f, 1},
+		{"split 10 iters", false, false, true, 10, 10, 0.0f, 1},
+		{"split block 10 iters", false, true, true, 10, 10, 0.0f, 1},
+		{"split adaptive 10/20", false, true, true, 10, 20, 0.001f, 1},
+		{"soft 4 substeps", true, false, false, 1, 1, 0.0f, 4},
+		{"soft 8 substeps", true, false, false, 1, 1, 0.0f, 8}};
+
+	printf("%-10s %-22s %6s %12s %8s %8s %8s %10s %10s %7s %8s\n", "scene", "solver", "passes", "ns/step", "mad", "pairs", "contacts", "drift", "speed", "cache", "collide");
+
+	std::vector<Result> results;
+	std::vector<std::vector<double> > times;
+
+	// Each repeat goes over every configuration once, so a slow spell of the
+	// machine spreads over all of them and shows up in their MADs instead
+	// of shifting the medians of a few.
+	for (int k = 0; k < repeat; ++k)
+	{
+		int index = 0;
+		for (int i = 0; i < (int)(sizeof(scenes) / sizeof(scenes[0])); ++i)
+		{
+			if (sceneName != NULL && strcmp(sceneName, scenes[i].name) != 0)
+				continue;
+
+			for (int j = 0; j < (int)(sizeof(settings) / sizeof(settings[0])); ++j, ++index)
+			{
+				if (k == 0)
+				{
+					results.push_back(Result());
+					times.push_back(std::vector<double>());
+				}
+
+				times[index].push_back(Run(scenes[i], settings[j], &results[index]));
+			}
+		}
+	}
+
+	for (int i = 0; i < (int)results.size(); ++i)
+	{
+		Result& r = results[i];
+		r.nsMedian = Median(times[i]);
+		r.nsMad = MedianAbsoluteDeviation(times[i], r.nsMedian);
+
+		printf("%-10s %-22s %6.1f %12.0f %8.0f %8.1f %8.1f %10.4f %10.4f %6.1f%% %8.1f\n", r.scene.c_str(), r.solver.c_str(),
+			r.passes, r.nsMedian, r.nsMad, r.pairs, r.contacts, r.drift, r.speed, r.hitRate, r.collide);
+	}
+
+	if (writePath != NULL && !WriteResults(writePath, results))
+		return 1;
+
+	if (baselinePath != NULL)
+	{
+		printf("\n");
+		if (Compare(results, baseline, threshold, checkTime) > 0)
+			return 1;
+	}
+
+	return 0;
+}
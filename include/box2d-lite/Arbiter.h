@@ -12,9 +12,9 @@
 #ifndef ARBITER_H
 #define ARBITER_H
 
+#include <vector>
 #include "MathUtils.h"
-
-struct Body;
+#include "Body.h"
 
 union FeaturePair
 {
@@ -28,27 +28,74 @@ union FeaturePair
 	int value;
 };
 
+enum Axis
+{
+	FACE_A_X,
+	FACE_A_Y,
+	FACE_B_X,
+	FACE_B_Y
+};
+
+// Face axis on which Collide() found a pair separated.
+struct SeparatingAxis
+{
+	Axis axis;
+	float separation;
+};
+
 struct Contact
 {
-	Contact() : Pn(0.0f), Pt(0.0f), Pnb(0.0f) {}
+	Contact() : Pn(0.0f), Pt(0.0f), Pnb(0.0f), childPair(0) {}
 
 	Vec2 position;
 	Vec2 normal;
 	Vec2 r1, r2;
+	Vec2 localAnchor1, localAnchor2;	// contact points in body frames
 	float separation;
 	float Pn;	// accumulated normal impulse
 	float Pt;	// accumulated tangent impulse
 	float Pnb;	// accumulated normal impulse for position bias
 	float massNormal, massTangent;
 	float bias;
+	float positionBias;	// pseudo velocity that removes the penetration (split impulse)
 	FeaturePair feature;
+	int childPair;	// compound or tile box pair, ((box1 + 1) << 16) | (box2 + 1), 0 otherwise
 };
 
+// Soft constraint coefficients for a given stiffness and sub-step.
+struct Softness
+{
+	Softness() : biasRate(0.0f), massScale(1.0f), impulseScale(0.0f) {}
+	Softness(float hertz, float dampingRatio, float h);
+
+	float biasRate;
+	float massScale;
+	float impulseScale;
+};
+
+// Orders bodies by broadphase proxy, which follows the order they were
+// added to the world. Ordering by address would make the solve order, and
+// so the results, depend on where the bodies happen to be allocated.
+inline bool BodyPrecedes(const Body* b1, const Body* b2)
+{
+	if (b1->proxyId != b2->proxyId)
+		return b1->proxyId < b2->proxyId;
+	return b1 < b2;
+}
+
+// The pair maps (World::arbiters, separatedPairs, sensorPairs) are ordered
+// by this key, and so by Body::proxyId, which is not const. A body's
+// proxyId must therefore stay fixed while any key holds it: the world sets
+// it in Add, and ApplyRemovals and Clear reset it only after the pairs of
+// that body are gone. Proxy ids are reused after removal, so a body added
+// later may sort before older ones; that is fine, as it stays put for the
+// body's lifetime. The tile body's TILE_PROXY (-2) sorts before every tree
+// proxy, so tile pairs come first in the maps.
 struct ArbiterKey
 {
 	ArbiterKey(Body* b1, Body* b2)
 	{
-		if (b1 < b2)
+		if (BodyPrecedes(b1, b2))
 		{
 			body1 = b1; body2 = b2;
 		}
@@ -64,15 +111,33 @@ struct ArbiterKey
 
 struct Arbiter
 {
-	enum {MAX_POINTS = 2};
+	// A box pair has at most two points. Compound pairs keep the deepest
+	// points of all their box pairs.
+	enum {MAX_POINTS = 4};
 
-	Arbiter(Body* b1, Body* b2);
+	Arbiter(Body* b1, Body* b2, float margin = 0.0f, SeparatingAxis* separatingAxis = NULL);
+	Arbiter(const ArbiterKey& key, const Contact* contacts, int numContacts);
 
 	void Update(Contact* contacts, int numContacts);
 
+	// Persistent manifold
+	void CacheRelativePose();
+	bool RefreshContacts();
+
 	void PreStep(float inv_dt);
 	//void ApplyImpulse();
-	void ApplyImpulse(Body**,int); // 바디의 포인터를 저장하는 배열을 매개변수로 받습니다. // Okay
+	float ApplyImpulse(Body**,int); // 바디의 포인터를 저장하는 배열을 매개변수로 받습니다. // Okay
+	float ApplyBlockImpulse();
+
+	// Split impulse pass on the bodies' pseudo velocities (see World::splitImpulse)
+	float ApplyPositionImpulse();
+
+	// Sub-stepping soft solver (see World::softStep)
+	void PreStepSoft();
+	void WarmStart();
+	void ApplySoftImpulse(float inv_h, const Softness& soft, bool useBias);
+
+	void CheckImpulseLimit(Body** deadBodyStoragePtr, int numStorage);
 
 	Contact contacts[MAX_POINTS];
 	int numContacts;
@@ -82,6 +147,25 @@ struct Arbiter
 
 	// Combined friction
 	float friction;
+
+	// Relative pose of the bodies when Collide() last computed the manifold
+	Vec2 relativePosition1;		// body2's origin in body1's frame
+	Vec2 relativePosition2;		// body1's origin in body2's frame
+	float relativeRotation;		// body2's rotation minus body1's
+	Vec2 localNormal;			// normal in body1's frame
+
+	// Block solver for two-point manifolds
+	Mat22 K;
+	Mat22 normalMass;
+	bool blockSolve;
+
+	// The contacts come from several box pairs and may not share a normal,
+	// so the block solver and the manifold cache are not used.
+	bool compound;
+	bool visited;	// found by the broadphase this step, compound only
+
+	// Largest velocity change from the last solver pass
+	float solveDelta;
 	
 	// 상태 저장 변수 추가
 	// (빙판)
@@ -91,15 +175,71 @@ struct Arbiter
 // This is used by std::set
 inline bool operator < (const ArbiterKey& a1, const ArbiterKey& a2)
 {
-	if (a1.body1 < a2.body1)
+	if (BodyPrecedes(a1.body1, a2.body1))
 		return true;
 
-	if (a1.body1 == a2.body1 && a1.body2 < a2.body2)
+	if (a1.body1 == a2.body1 && BodyPrecedes(a1.body2, a2.body2))
 		return true;
 
 	return false;
 }
 
-int Collide(Contact* contacts, Body* body1, Body* body2);
+// Box pose with the rotation matrix already evaluated.
+struct BoxTransform
+{
+	BoxTransform() {}
+	explicit BoxTransform(const Body* body);
+	BoxTransform(const BoxTransform& body, const BoxShape& box);	// box of a compound body
+
+	Vec2 position;
+	Mat22 rotation;
+	Vec2 halfWidth;
+};
+
+// Box pairs for CollideBatch(), stored one array per component so the face
+// tests can load several pairs at once. Rotations are kept as cosine/sine.
+struct BoxPairBatch
+{
+	void Clear();
+	void Add(const BoxTransform& A, const BoxTransform& B, float margin);
+	int Size() const { return (int)margin.size(); }
+
+	BoxTransform TransformA(int i) const;
+	BoxTransform TransformB(int i) const;
+
+	std::vector<float> pAx, pAy, cA, sA, hAx, hAy;
+	std::vector<float> pBx, pBy, cB, sB, hBx, hBy;
+	std::vector<float> margin;
+};
+
+// Contacts of one touching pair from CollideBatch().
+struct Manifold
+{
+	int pair;	// index into the batch
+	int numContacts;
+	Contact contacts[2];
+};
+
+int Collide(Contact* contacts, Body* body1, Body* body2, float margin = 0.0f, SeparatingAxis* separatingAxis = NULL);
+int CollideBoxes(Contact* contacts, const BoxTransform& A, const BoxTransform& B, float margin = 0.0f, SeparatingAxis* separatingAxis = NULL);
+float SeparationOnAxis(Body* body1, Body* body2, Axis axis);
+
+// Exact ray test against a box. On a hit within maxFraction of p1 -> p2,
+// writes the fraction and the outward face normal. Rays starting inside the
+// box do not hit it.
+bool RayCastBox(float* fraction, Vec2* normal, const BoxTransform& box, const Vec2& p1, const Vec2& p2, float maxFraction);
+
+// Exact box-box tests. TestOverlapBoxes counts touching boxes as
+// overlapping. BoxCastBox sweeps A along translation without rotating it
+// and reports the first time of impact within maxFraction and the normal of
+// B's side pointing at A. Boxes that already overlap hit at fraction zero,
+// with the normal of the axis along which they overlap the least.
+bool TestOverlapBoxes(const BoxTransform& A, const BoxTransform& B);
+bool BoxCastBox(float* fraction, Vec2* normal, const BoxTransform& A, const Vec2& translation, const BoxTransform& B, float maxFraction);
+
+// Collides every pair of the batch. Touching pairs are packed into manifolds
+// in batch order; separatingAxes receives one entry per pair, with zero
+// separation for pairs that were not separated by more than their margin.
+int CollideBatch(std::vector<Manifold>& manifolds, SeparatingAxis* separatingAxes, const BoxPairBatch& batch);
 
 #endif
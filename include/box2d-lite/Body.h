@@ -12,37 +12,137 @@
 #ifndef BODY_H
 #define BODY_H
 
+#include <vector>
 #include "MathUtils.h"
 
+// Static bodies never move. Kinematic bodies move by their velocity but are
+// not pushed by contacts, joints or gravity. Both have zero inverse mass.
+enum BodyType
+{
+	STATIC_BODY,
+	KINEMATIC_BODY,
+	DYNAMIC_BODY
+};
+
+// One box of a compound body, placed in the body frame.
+struct BoxShape
+{
+	BoxShape() : position(0.0f, 0.0f), rotation(0.0f), proxyId(-1) {}
+	BoxShape(const Vec2& width, const Vec2& position, float rotation = 0.0f) :
+		width(width), position(position), rotation(rotation), rot(rotation), proxyId(-1) {}
+
+	Vec2 width;
+	Vec2 position;
+	float rotation;
+	Rot rot;
+	int proxyId;	// broadphase tree proxy, -1 when not in a world
+};
+
 struct Body
 {
 	Body();
 	void Set(const Vec2& w, float m);
 
+	// Makes a rigid body out of several boxes sharing the mass by area. The
+	// boxes are shifted so their centroid is the body origin, and width
+	// becomes the extent of the boxes around it. Returns the centroid in the
+	// frame the boxes were given in. A static compound is placed when it is
+	// added to the world; remove and add it again to move it. The boxes must
+	// have a nonzero total area.
+	Vec2 SetCompound(const BoxShape* shapes, int count, float m);
+
+	// Switches the type after Set. A dynamic body takes its inverse mass back
+	// from mass, so a body created with FLT_MAX mass stays immovable.
+	void SetType(BodyType t);
+
 	void AddForce(const Vec2& f)
 	{
 		force += f;
 	}
 	void setPosition2(Vec2& v);
 
+	// Advances rotation and rot together.
+	void Rotate(float angle)
+	{
+		if (angle == 0.0f)
+			return;
+
+		rotation += angle;
+		rot = IntegrateRotation(rot, angle);
+		rotAngle = rotation;
+	}
+
+	// Recomputes rot after rotation was written directly. The world does
+	// this when a body is added and at the start of every step.
+	void SyncRotation()
+	{
+		if (rotation != rotAngle)
+		{
+			rot = Rot(rotation);
+			rotAngle = rotation;
+		}
+	}
+
+	// Teleports the body. The previous pose moves too, so interpolation
+	// does not draw it sliding over from where it was.
+	void SetTransform(const Vec2& p, float angle)
+	{
+		position = p;
+		rotation = angle;
+		SyncRotation();
+		previousPosition = p;
+		previousRotation = angle;
+	}
+
 	Vec2 position;
-	float rotation;
+	float rotation;		// angle in radians
+
+	// rotation as (cos, sin), used by collision and the solver
+	Rot rot;
+	float rotAngle;		// the angle rot was last computed for
+
+	// Pose before the last fixed step, for interpolation (see World::Advance)
+	Vec2 previousPosition;
+	float previousRotation;
 
 	Vec2 velocity;
 	float angularVelocity;
 
+	// Pseudo velocity from the split impulse pass. It moves the body for one
+	// step and is then discarded, so it adds no momentum.
+	Vec2 biasVelocity;
+	float biasAngularVelocity;
+
 	Vec2 force;
 	float torque;
 
 	Vec2 width;
+	std::vector<BoxShape> boxes;	// empty unless compound, then width is only a bound
 
 	float friction;
+	BodyType type;
+
+	// Collision filter. Two bodies collide when each one's category is in the
+	// other's mask. A shared nonzero group overrides the bits: positive groups
+	// always collide, negative groups never do.
+	unsigned int categoryBits;
+	unsigned int maskBits;
+	int groupIndex;
+
+	// Sensors only report overlaps (see World::sensorBeginEvents). They get
+	// no contacts and do not see other sensors, nor a static sensor static
+	// bodies. A pair the filter rejects ends its overlap. Set before adding
+	// the body.
+	bool isSensor;
+
 	float mass, invMass;
 	float I, invI;
 	
 	float impulseLimit;
 	bool isBreakAble;
 	bool isItExist = true;
+
+	int proxyId;	// broadphase tree proxy, -1 when not in a world
 };
 
 #endif
@@ -0,0 +1,62 @@
+/*
+* Copyright (c) 2006-2009 Erin Catto http://www.gphysics.com
+*
+* Permission to use, copy, modify, distribute and sell this software
+* and its documentation for any purpose is hereby granted without fee,
+* provided that the above copyright notice appear in all copies.
+* Erin Catto makes no representations about the suitability
+* of this software for any purpose.
+* It is provided "as is" without express or implied warranty.
+*/
+
+#ifndef DEBUGDRAW_H
+#define DEBUGDRAW_H
+
+#include <vector>
+#include "MathUtils.h"
+
+struct Body;
+struct WorldSnapshot;
+
+struct Color
+{
+	Color() {}
+	Color(float r, float g, float b) : r(r), g(g), b(b) {}
+
+	float r, g, b;
+};
+
+// Interleaved position and color, ready for glVertexPointer/glColorPointer.
+struct DebugVertex
+{
+	Vec2 position;
+	Color color;
+};
+
+// CPU vertex buffer of debug geometry for one frame. Lines are stored as
+// vertex pairs (GL_LINES) and points one vertex each (GL_POINTS), so either
+// array can be drawn or rasterized in a single pass.
+struct DebugDraw
+{
+	DebugDraw();
+
+	void Clear();
+	void AddLine(const Vec2& p1, const Vec2& p2, const Color& color);
+	void AddPoint(const Vec2& p, const Color& color);
+	void AddBox(const Vec2& position, float rotation, const Vec2& width, const Color& color);
+
+	// Outlines of the bodies, joint lines and contact points.
+	void AddSnapshot(const WorldSnapshot& snapshot);
+
+	std::vector<DebugVertex> lines;
+	std::vector<DebugVertex> points;
+
+	Color bodyColor;
+	Color brokenBodyColor;
+	Color highlightColor;
+	Color jointColor;
+	Color contactColor;
+	const Body* highlight;	// drawn in highlightColor, may be NULL
+};
+
+#endif
@@ -0,0 +1,226 @@
+/*
+* Copyright (c) 2009 Erin Catto http://www.gphysics.com
+*
+* Permission to use, copy, modify, distribute and sell this software
+* and its documentation for any purpose is hereby granted without fee,
+* provided that the above copyright notice appear in all copies.
+* Erin Catto makes no representations about the suitability
+* of this software for any purpose.
+* It is provided "as is" without express or implied warranty.
+*/
+
+#ifndef DYNAMICTREE_H
+#define DYNAMICTREE_H
+
+#include <assert.h>
+#include <vector>
+#include "MathUtils.h"
+
+// Axis-aligned bounding box
+struct AABB
+{
+	AABB() {}
+	AABB(const Vec2& lowerBound, const Vec2& upperBound) : lowerBound(lowerBound), upperBound(upperBound) {}
+
+	Vec2 GetCenter() const { return 0.5f * (lowerBound + upperBound); }
+	Vec2 GetExtents() const { return 0.5f * (upperBound - lowerBound); }
+
+	float GetPerimeter() const
+	{
+		return 2.0f * ((upperBound.x - lowerBound.x) + (upperBound.y - lowerBound.y));
+	}
+
+	bool Contains(const AABB& aabb) const
+	{
+		return lowerBound.x <= aabb.lowerBound.x && lowerBound.y <= aabb.lowerBound.y
+			&& aabb.upperBound.x <= upperBound.x && aabb.upperBound.y <= upperBound.y;
+	}
+
+	Vec2 lowerBound;
+	Vec2 upperBound;
+};
+
+inline AABB Combine(const AABB& a, const AABB& b)
+{
+	return AABB(Vec2(Min(a.lowerBound.x, b.lowerBound.x), Min(a.lowerBound.y, b.lowerBound.y)),
+				Vec2(Max(a.upperBound.x, b.upperBound.x), Max(a.upperBound.y, b.upperBound.y)));
+}
+
+inline AABB Fatten(const AABB& a, float r)
+{
+	return AABB(a.lowerBound - Vec2(r, r), a.upperBound + Vec2(r, r));
+}
+
+inline bool TestOverlap(const AABB& a, const AABB& b)
+{
+	if (b.lowerBound.x > a.upperBound.x || b.lowerBound.y > a.upperBound.y)
+		return false;
+
+	if (a.lowerBound.x > b.upperBound.x || a.lowerBound.y > b.upperBound.y)
+		return false;
+
+	return true;
+}
+
+struct TreeNode
+{
+	bool IsLeaf() const { return child1 == -1; }
+
+	AABB aabb;
+	int userData;
+	int parent;		// next free node while on the free list
+	int child1;
+	int child2;
+	int height;		// leaf = 0, free node = -1
+};
+
+// Bounding volume hierarchy of fat AABBs, one leaf per proxy. A proxy only
+// moves in the tree when its tight AABB leaves the fat one, so most steps
+// leave the tree untouched. Nodes live in one array and are referred to by
+// index, so the tree can grow without invalidating proxy ids.
+struct DynamicTree
+{
+	enum { NULL_NODE = -1, STACK_SIZE = 256 };
+
+	DynamicTree();
+
+	int CreateProxy(const AABB& aabb, int userData);
+	void DestroyProxy(int proxyId);
+
+	// Reinserts the proxy with a new fat AABB.
+	void MoveProxy(int proxyId, const AABB& aabb);
+
+	void Clear();
+
+	int GetUserData(int proxyId) const { return nodes[proxyId].userData; }
+	void SetUserData(int proxyId, int userData) { nodes[proxyId].userData = userData; }
+	const AABB& GetFatAABB(int proxyId) const { return nodes[proxyId].aabb; }
+	int GetHeight() const { return root == NULL_NODE ? 0 : nodes[root].height; }
+
+	// Calls callback->QueryCallback(proxyId) for each proxy whose fat AABB
+	// overlaps aabb. Returning false stops the query.
+	template <typename T>
+	void Query(T* callback, const AABB& aabb) const;
+
+	// Calls callback->RayCastCallback(p1, p2, maxFraction, proxyId) for each
+	// proxy whose fat AABB the segment p1 + t * (p2 - p1), t <= maxFraction,
+	// crosses. The callback returns the new maxFraction: 0 stops the cast, a
+	// negative value leaves the segment unchanged.
+	template <typename T>
+	void RayCast(T* callback, const Vec2& p1, const Vec2& p2, float maxFraction) const;
+
+	// Same as RayCast for an AABB with the given half extents swept from p1
+	// to p2. The callback gets the path of the AABB center.
+	template <typename T>
+	void SweepAABB(T* callback, const Vec2& p1, const Vec2& p2, const Vec2& extents, float maxFraction) const;
+
+	int AllocateNode();
+	void FreeNode(int node);
+
+	void InsertLeaf(int leaf);
+	void RemoveLeaf(int leaf);
+	int Balance(int index);
+
+	int root;
+	std::vector<TreeNode> nodes;
+	int freeList;
+};
+
+template <typename T>
+inline void DynamicTree::Query(T* callback, const AABB& aabb) const
+{
+	int stack[STACK_SIZE];
+	int count = 0;
+	stack[count++] = root;
+
+	while (count > 0)
+	{
+		int nodeId = stack[--count];
+		if (nodeId == NULL_NODE)
+			continue;
+
+		const TreeNode& node = nodes[nodeId];
+		if (!TestOverlap(node.aabb, aabb))
+			continue;
+
+		if (node.IsLeaf())
+		{
+			if (!callback->QueryCallback(nodeId))
+				return;
+		}
+		else
+		{
+			assert(count + 2 <= STACK_SIZE);
+			stack[count++] = node.child1;
+			stack[count++] = node.child2;
+		}
+	}
+}
+
+template <typename T>
+inline void DynamicTree::RayCast(T* callback, const Vec2& p1, const Vec2& p2, float maxFraction) const
+{
+	SweepAABB(callback, p1, p2, Vec2(0.0f, 0.0f), maxFraction);
+}
+
+template <typename T>
+inline void DynamicTree::SweepAABB(T* callback, const Vec2& p1, const Vec2& p2, const Vec2& extents, float maxFraction) const
+{
+	Vec2 r = p2 - p1;
+	float length = r.Length();
+	if (length == 0.0f)
+		return;
+	r = (1.0f / length) * r;
+
+	// Separating axis for the segment
+	Vec2 v = Cross(1.0f, r);
+	Vec2 abs_v = Abs(v);
+
+	Vec2 t = p1 + maxFraction * (p2 - p1);
+	AABB segmentAABB(Vec2(Min(p1.x, t.x), Min(p1.y, t.y)) - extents, Vec2(Max(p1.x, t.x), Max(p1.y, t.y)) + extents);
+
+	int stack[STACK_SIZE];
+	int count = 0;
+	stack[count++] = root;
+
+	while (count > 0)
+	{
+		int nodeId = stack[--count];
+		if (nodeId == NULL_NODE)
+			continue;
+
+		const TreeNode& node = nodes[nodeId];
+		if (!TestOverlap(node.aabb, segmentAABB))
+			continue;
+
+		// |dot(v, p1 - c)| > dot(|v|, h) means the line misses the box.
+		Vec2 c = node.aabb.GetCenter();
+		Vec2 h = node.aabb.GetExtents();
+		float separation = Abs(Dot(v, p1 - c)) - Dot(abs_v, h + extents);
+		if (separation > 0.0f)
+			continue;
+
+		if (node.IsLeaf())
+		{
+			float value = callback->RayCastCallback(p1, p2, maxFraction, nodeId);
+
+			if (value == 0.0f)
+				return;
+
+			if (value > 0.0f)
+			{
+				maxFraction = value;
+				t = p1 + maxFraction * (p2 - p1);
+				segmentAABB = AABB(Vec2(Min(p1.x, t.x), Min(p1.y, t.y)) - extents, Vec2(Max(p1.x, t.x), Max(p1.y, t.y)) + extents);
+			}
+		}
+		else
+		{
+			assert(count + 2 <= STACK_SIZE);
+			stack[count++] = node.child1;
+			stack[count++] = node.child2;
+		}
+	}
+}
+
+#endif
@@ -21,13 +21,14 @@ struct Joint
 	Joint() :
 		body1(0), body2(0),
 		P(0.0f, 0.0f),
-		biasFactor(0.2f), softness(0.0f)
+		biasFactor(0.2f), softness(0.0f), solveDelta(0.0f),
+		collideConnected(false), index(-1)
 		{}
 
 	void Set(Body* body1, Body* body2, const Vec2& anchor);
 
 	void PreStep(float inv_dt);
-	void ApplyImpulse();
+	float ApplyImpulse();
 
 	Mat22 M;
 	Vec2 localAnchor1, localAnchor2;
@@ -38,6 +39,9 @@ struct Joint
 	Body* body2;
 	float biasFactor;
 	float softness;
+	float solveDelta;	// largest velocity change from the last solver pass
+	bool collideConnected;	// false: body1 and body2 get no contacts
+	int index;			// position in World::joints, -1 when not in a world
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,112 @@
+/*
+* Copyright (c) 2006-2009 Erin Catto http://www.gphysics.com
+*
+* Permission to use, copy, modify, distribute and sell this software
+* and its documentation for any purpose is hereby granted without fee,
+* provided that the above copyright notice appear in all copies.
+* Erin Catto makes no representations about the suitability
+* of this software for any purpose.
+* It is provided "as is" without express or implied warranty.
+*/
+
+#ifndef SCENEBUILDER_H
+#define SCENEBUILDER_H
+
+#include <deque>
+#include "MathUtils.h"
+#include "Body.h"
+#include "Joint.h"
+
+struct World;
+
+// Small deterministic generator (xorshift32), so scenes do not depend on
+// rand() and rebuild identically from the same seed.
+struct SceneRandom
+{
+	explicit SceneRandom(unsigned int seed) { Seed(seed); }
+
+	void Seed(unsigned int seed) { state = seed != 0 ? seed : 0x9e3779b9u; }
+
+	// Uniform in [lo, hi]
+	float Next(float lo, float hi)
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		return lo + (hi - lo) * ((state >> 8) * (1.0f / 16777215.0f));
+	}
+
+	unsigned int state;
+};
+
+// Owns the bodies and joints of a scene and adds them to a world. Storage
+// is a deque, so pointers stay valid as the scene grows and there is no
+// fixed body count. The generators place their shapes relative to an
+// origin and can be combined in one scene.
+struct SceneBuilder
+{
+	SceneBuilder(World* world, unsigned int seed = 1);
+
+	// Empties the world and the storage and restarts the generator.
+	void Clear(unsigned int seed = 1);
+
+	Body* AddBox(const Vec2& position, const Vec2& width, float mass, float rotation = 0.0f);
+	Body* AddGround(float width = 100.0f);
+
+	// One rigid body made of the given boxes, placed relative to position.
+	Body* AddCompound(const Vec2& position, const BoxShape* boxes, int count, float mass, float rotation = 0.0f);
+	Joint* AddJoint(Body* body1, Body* body2, const Vec2& anchor);
+
+	// Soft joint with the given spring frequency and damping ratio.
+	Joint* AddSpringJoint(Body* body1, Body* body2, const Vec2& anchor, float hertz, float dampingRatio, float timeStep);
+
+	// Rows of boxes with the given gap, each row shifted by half a box. The
+	// bottom row is centred on base.
+	void Pyramid(int rows, const Vec2& base, const Vec2& boxWidth, float mass, const Vec2& spacing = Vec2(0.125f, 0.0f));
+
+	// Brick wall of running bond standing on base, centred on base.x.
+	void Wall(int columns, int rows, const Vec2& base, const Vec2& brickWidth, float mass);
+
+	// A line of thin dominoes standing on y = base.y, the first one tipped.
+	void Dominoes(int count, const Vec2& base, float spacing, const Vec2& width, float mass);
+
+	// Chain of boxes hanging to the right from anchor on the given body.
+	void Chain(Body* anchorBody, const Vec2& anchor, int links, const Vec2& linkWidth, float mass);
+
+	// Torso, head, arms and legs joined at the shoulders, hips and neck.
+	void Ragdoll(const Vec2& position, float scale, float mass);
+	void Ragdolls(int count, const Vec2& origin, float spacing, float scale, float mass);
+
+	// Random boxes on a jittered grid of the given width, centred on base.x
+	// and filled upward from base.y. No two start overlapping.
+	void RandomPile(int count, const Vec2& base, float width, float minSize, float maxSize, float mass);
+
+	// Drops count boxes at height y spread over [xMin, xMax]. Slots still
+	// covered by a body are skipped. Returns the number of boxes added.
+	// Call every step, or use RainEmitter, to keep them coming.
+	int Rain(int count, float xMin, float xMax, float y, float minSize, float maxSize, float mass);
+
+	World* world;
+	SceneRandom random;
+	std::deque<Body> bodies;
+	std::deque<Joint> joints;
+};
+
+// Emits rain at a fixed rate (bodies per second) over time.
+struct RainEmitter
+{
+	RainEmitter() : rate(60.0f), xMin(-10.0f), xMax(10.0f), y(20.0f),
+		minSize(0.25f), maxSize(1.0f), mass(1.0f), maxBodies(1000000), accumulator(0.0f) {}
+
+	// Returns the number of bodies emitted.
+	int Update(SceneBuilder& scene, float dt);
+
+	float rate;
+	float xMin, xMax, y;
+	float minSize, maxSize;
+	float mass;
+	int maxBodies;	// stops once the scene holds this many bodies
+	float accumulator;
+};
+
+#endif
@@ -0,0 +1,83 @@
+/*
+* Copyright (c) 2006-2009 Erin Catto http://www.gphysics.com
+*
+* Permission to use, copy, modify, distribute and sell this software
+* and its documentation for any purpose is hereby granted without fee,
+* provided that the above copyright notice appear in all copies.
+* Erin Catto makes no representations about the suitability
+* of this software for any purpose.
+* It is provided "as is" without express or implied warranty.
+*/
+
+#ifndef TILEMAP_H
+#define TILEMAP_H
+
+#include <vector>
+#include "MathUtils.h"
+#include "Arbiter.h"
+#include "DynamicTree.h"
+
+// How far a box may reach past a corner, or sink into a face, and its
+// contact still be taken for a ghost on a face inside the level
+const float k_tileSlop = 0.05f;
+
+// Solid cells merged into one axis-aligned rectangle, in cells.
+struct TileRect
+{
+	int x, y;
+	int width, height;
+};
+
+// Static collision grid owned by the world. Solid cells are merged into as
+// few rectangles as a greedy scan finds, and bodies look up the cells they
+// overlap directly, so tiles take no bodies, proxies or broadphase pairs.
+// Cell (0, 0) has its lower left corner at origin. Each cell costs five
+// bytes: its solid flag and the index of the rect covering it.
+struct TileMap
+{
+	// Stands in for the tree proxy of the tile body: not in the tree, but
+	// counted as part of the world.
+	enum { TILE_PROXY = -2 };
+
+	TileMap();
+
+	// Resizes the grid and empties every cell.
+	void Set(int w, int h, const Vec2& size, const Vec2& o = Vec2(0.0f, 0.0f));
+	void Clear();
+
+	void SetSolid(int x, int y, bool solid);
+	bool IsSolid(int x, int y) const;
+
+	// Merges the solid cells into rects. The world calls this before a step
+	// whenever cells changed.
+	void Rebuild();
+
+	// Collects the rects overlapping the box, each once.
+	void Query(std::vector<int>& results, const AABB& aabb);
+
+	BoxTransform GetRectTransform(int rect) const;
+
+	// A contact on the face of a rect is a ghost when the face is inside the
+	// level: solid cells cover it along the whole span of the touching box,
+	// less k_tileSlop at either end. The normal points out of the rect. A
+	// box that reaches past a corner of the level sees the open cell there,
+	// so its contact stays.
+	bool IsInternalFace(int rect, const Vec2& normal, const AABB& box) const;
+
+	int width, height;
+	Vec2 cellSize;
+	Vec2 origin;
+	std::vector<unsigned char> cells;	// 1 for solid, row by row
+	std::vector<int> cellRects;			// rect covering each cell, -1 if empty
+	std::vector<TileRect> rects;
+	bool dirty;
+
+	// Static body the tile contacts refer to, at the world origin.
+	Body body;
+
+	// Query scratch: the query count each rect was last reported for
+	std::vector<int> rectStamps;
+	int queryStamp;
+};
+
+#endif
@@ -14,33 +14,306 @@
 
 #include <vector>
 #include <map>
+#include <set>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include "MathUtils.h"
 #include "Arbiter.h"
+#include "DynamicTree.h"
+#include "TileMap.h"
 
 struct Body;
 struct Joint;
 
+// Broadphase cache entry for a pair that was not touching. The pair is
+// skipped until the bodies have moved far enough to close the gap.
+struct SeparatedPair
+{
+	SeparatingAxis separatingAxis;
+	Vec2 position1, position2;		// body poses when the gap was measured
+	float rotation1, rotation2;
+};
+
+// Broadphase candidate: the body a query found and the overlapping proxies.
+// Compound bodies give one candidate per overlapping box pair.
+struct PairCandidate
+{
+	int body;
+	int proxy1;		// proxy of the querying body
+	int proxy2;
+};
+
+// Statistics gathered during the last call to World::Step.
+struct Profile
+{
+	Profile() :
+		iterations(0), extraIterations(0), positionIterations(0),
+		broadphasePairs(0), narrowphaseCalls(0), manifoldCacheHits(0), manifoldCacheMisses(0),
+		separatedPairSkips(0), separatingAxisHits(0), filteredPairs(0),
+		tileRectTests(0), tileFaceRejects(0) {}
+
+	int iterations;			// full velocity passes
+	int extraIterations;	// passes over constraints that had not converged
+	int positionIterations;	// split impulse passes
+
+	int broadphasePairs;		// pairs whose fat AABBs overlap
+	int narrowphaseCalls;		// calls to Collide()
+	int manifoldCacheHits;		// touching pairs that reused their manifold
+	int manifoldCacheMisses;	// touching pairs that moved too far and were collided again
+
+	int separatedPairSkips;		// separated pairs that could not have closed their gap
+	int separatingAxisHits;		// separated pairs confirmed by their cached axis alone
+
+	int filteredPairs;			// overlapping pairs rejected by filter bits or a joint
+
+	int tileRectTests;			// box against tile rect collisions
+	int tileFaceRejects;		// tile contacts dropped on faces inside the level
+};
+
+// A body started or stopped overlapping a sensor.
+struct SensorEvent
+{
+	Body* sensor;
+	Body* visitor;
+};
+
+// Two bodies started or stopped touching. Bodies in an end event may have
+// just been removed from the world.
+struct ContactEvent
+{
+	Body* body1;
+	Body* body2;
+};
+
+// The strongest point of a contact whose normal impulse went over
+// World::hitImpulseThreshold during the step.
+struct ContactHitEvent
+{
+	Body* body1;
+	Body* body2;
+	Vec2 point;
+	Vec2 normal;	// points from body1 to body2
+	float impulse;	// accumulated normal impulse, Pn
+};
+
+// Closest hit of a ray cast against the world.
+struct RayCastHit
+{
+	Body* body;		// NULL if the ray hit nothing
+	Vec2 point;
+	Vec2 normal;
+	float fraction;	// hit point = p1 + fraction * (p2 - p1)
+};
+
+struct RayCastInput
+{
+	Vec2 p1, p2;
+};
+
+// Hook into the game's job system. A scheduler runs task over all of
+// [0, count), split into ranges on whatever threads it owns, and returns
+// once every range is done.
+typedef void RangeTask(int begin, int end, void* taskContext);
+typedef void RangeScheduler(RangeTask* task, void* taskContext, int count, void* userContext);
+
+// First hit of a box swept through the world.
+struct BoxCastHit
+{
+	Body* body;		// NULL if the box hit nothing
+	Vec2 normal;	// surface normal of the body that was hit
+	float fraction;	// the box reaches it at p1 + fraction * (p2 - p1)
+};
+
+// Read-only copy of the world after a step, for drawing and game logic
+// while the next step runs.
+struct BodySnapshot
+{
+	const Body* body;	// identifies the body, do not read through it
+	Vec2 position;		// interpolated, see World::GetInterpolatedTransform
+	float rotation;
+	Vec2 width;
+	std::vector<BoxShape> boxes;	// compound boxes in the body frame
+	bool exists;
+};
+
+struct JointSnapshot
+{
+	Vec2 position1, anchor1;	// body origins and world anchors
+	Vec2 position2, anchor2;
+};
+
+struct ContactSnapshot
+{
+	Vec2 position;
+	Vec2 normal;
+	float separation;
+};
+
+struct WorldSnapshot
+{
+	std::vector<BodySnapshot> bodies;	// same order as World::bodies
+	std::vector<JointSnapshot> joints;
+	std::vector<ContactSnapshot> contacts;
+	std::vector<AABB> tiles;	// merged tile rects
+	Profile profile;
+};
+
 struct World
 {
-	World(Vec2 gravity, int iterations) : gravity(gravity), iterations(iterations) {}
+	World(Vec2 gravity, int iterations) :
+		gravity(gravity), iterations(iterations), maxIterations(iterations),
+		convergenceTolerance(0.001f), subSteps(4), positionIterations(4), hitImpulseThreshold(0.0f),
+		fixedTimeStep(1.0f / 60.0f), maxFixedSteps(5), accumulator(0.0f), interpolationAlpha(1.0f),
+		frontSnapshot(0), stepPending(false), stepDone(false), asyncFixed(false), quit(false), asyncDt(0.0f) {}
+	~World();
 
 	void Add(Body* body);
 	void Add(Joint* joint);
 	void Clear();
 	void Step(float dt);
 
-	void BroadPhase();
+	// Empties the event vectors below. Step and Advance do this when they
+	// start, so events from an ApplyRemovals called between steps last
+	// until the next one.
+	void ClearEvents();
+
+	// Deferred removal, so bodies and joints can be removed in bulk and from
+	// inside game logic. Queued removals are applied when the next Step
+	// starts and when it finishes. A body takes its joints, arbiters and
+	// broadphase proxy with it; bodies broken by the impulse limit are
+	// removed the same way. The world does not own bodies or joints, so
+	// nothing is freed and a removed body may be added again.
+	void Remove(Body* body);
+	void Remove(Joint* joint);
+	void ApplyRemovals();
+
+	// Fixed time step driven by real elapsed time. Runs as many steps of
+	// fixedTimeStep as the accumulated time allows, at most maxFixedSteps;
+	// time beyond that is dropped so a slow frame cannot snowball. Returns
+	// the number of steps taken. The events then cover all of those steps.
+	int Advance(float elapsedTime);
+
+	// Pose blended between the last two fixed steps by the time left over in
+	// the accumulator. After a plain Step this is the current pose. Move
+	// bodies between steps with Body::SetTransform so they do not smear.
+	void GetInterpolatedTransform(const Body* body, Vec2* position, float* rotation) const;
+
+	// Asynchronous stepping. StepAsync runs Step on a worker thread and
+	// returns at once. Until WaitStep returns, the world and its bodies and
+	// joints belong to the worker; only GetSnapshot may be used. WaitStep
+	// publishes the state after the step as the new snapshot.
+	void StepAsync(float dt);
+	void AdvanceAsync(float elapsedTime);
+	void WaitStep();
+	const WorldSnapshot& GetSnapshot() const { return snapshots[frontSnapshot]; }
+	void WriteSnapshot(WorldSnapshot& snapshot) const;
+
+	// Queries against the broadphase tree. Results go into the caller's
+	// buffers. Bodies that were broken off are not reported.
+	bool RayCast(RayCastHit* hit, const Vec2& p1, const Vec2& p2) const;
+	int QueryAABB(Body** bodies, int capacity, const AABB& aabb) const;
+
+	// One hit per ray. Without a scheduler the rays are cast on the calling
+	// thread. The world creates no threads and allocates nothing here; the
+	// world must not be stepped meanwhile.
+	void RayCastBatch(RayCastHit* hits, const RayCastInput* rays, int count, RangeScheduler* schedule = NULL, void* userContext = NULL) const;
+
+	// A box with the given width and rotation, as on Body, moved without
+	// turning from p1 to p2 or tested in place. The ignored body, usually
+	// the one the box stands for, is skipped.
+	bool BoxCast(BoxCastHit* hit, const Vec2& width, float rotation, const Vec2& p1, const Vec2& p2, const Body* ignore = NULL) const;
+	int OverlapBox(Body** bodies, int capacity, const Vec2& width, float rotation, const Vec2& position, const Body* ignore = NULL) const;
+
+	void BroadPhase(float dt);
+	void UpdateSensorPair(Body* b1, Body* b2, bool touching);
+	void CollideCompound(const ArbiterKey& key, const PairCandidate* pairs, int count, int index1, int index2, float margin);
+	void CollideTiles(int index, float margin);
+	void UpdateMergedArbiter(const ArbiterKey& key, Contact* contacts, int numContacts);
+	bool ProxiesOverlap(const Body* b1, const Body* b2) const;
+	BoxTransform PairBox(int proxyId, int bodyIndex) const;
+
+	// Current pose of the box behind a tree proxy.
+	BoxTransform GetProxyBox(int proxyId) const;
+	bool SeparationHolds(const ArbiterKey& key, SeparatedPair& sp, float margin);
+	void Simulate(float dt);	// Step without clearing the events
+	void SoftStep(float dt);
+	void GatherHitEvents();
 
 	std::vector<Body*> bodies;
 	std::vector<Joint*> joints;
 	std::map<ArbiterKey, Arbiter> arbiters;
+	std::map<ArbiterKey, SeparatedPair> separatedPairs;
+	std::set<ArbiterKey> sensorPairs;	// sensor pairs overlapping after the last step
+	DynamicTree tree;	// one proxy per box, user data is the index in bodies
+	std::vector<int> proxyBoxes;	// box index behind each proxy, -1 for a single-box body
+
+	// Static level geometry. Dynamic bodies look up the cells under their
+	// boxes each step; the tiles have no proxies and pair with nothing else.
+	TileMap tiles;
+
+	// Broadphase and narrowphase scratch, reused every step
+	std::vector<BoxTransform> transforms;
+	std::vector<PairCandidate> candidates;
+	BoxPairBatch batch;
+	std::vector<ArbiterKey> batchKeys;
+	std::vector<SeparatingAxis> batchAxes;
+	std::vector<int> tileRects;
+	std::vector<Manifold> manifolds;
+	std::vector<std::pair<Body*, Body*> > jointedPairs;	// sorted, from joints that do not collide
+
+	// Removals waiting for ApplyRemovals
+	std::vector<Body*> removedBodies;
+	std::vector<Joint*> removedJoints;
 	//std::vector<Body*> deadBodies;
 	Body* deadBodyStorage[200] = { NULL, }; // Okay
 	Vec2 gravity;
 	int iterations;
+	int maxIterations;				// hard cap including extra passes
+	float convergenceTolerance;		// velocity change (m/s) below which the solver stops early
+	int subSteps;
+	int positionIterations;			// split impulse passes per step
+	float hitImpulseThreshold;		// normal impulse that makes a hit event, 0 for none
+	float fixedTimeStep;
+	int maxFixedSteps;
+	float accumulator;
+	float interpolationAlpha;
+	Profile profile;
+
+	// Overlaps that began or ended during the last Step or Advance,
+	// including bodies removed while overlapping a sensor. Cleared when the
+	// next one starts.
+	std::vector<SensorEvent> sensorBeginEvents;
+	std::vector<SensorEvent> sensorEndEvents;
+
+	// Contact events of the last Step or Advance, filled outside the solver
+	// and cleared when the next one starts. A begin event means an arbiter
+	// was created, an end event that it was destroyed.
+	std::vector<ContactEvent> contactBeginEvents;
+	std::vector<ContactEvent> contactEndEvents;
+	std::vector<ContactHitEvent> contactHitEvents;
+
+	// Async step worker and the two snapshot buffers
+	void AsyncLoop();
+	WorldSnapshot snapshots[2];
+	int frontSnapshot;
+	std::thread worker;
+	std::mutex asyncMutex;
+	std::condition_variable asyncCondition;
+	bool stepPending;
+	bool stepDone;
+	bool asyncFixed;	// the pending task is Advance rather than Step
+	bool quit;
+	float asyncDt;
+
 	static bool accumulateImpulses;
 	static bool warmStarting;
 	static bool positionCorrection;
+	static bool speculativeContacts;
+	static bool softStep;
+	static bool blockSolver;
+	static bool splitImpulse;
+	static bool manifoldCaching;
 	static bool Moter;	//모터 작동 문구용
 };
 
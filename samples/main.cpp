@@ -11,6 +11,10 @@
 
 #define _CRT_SECURE_NO_WARNINGS
 #include <stdio.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
 
 #include "imgui/imgui.h"
 #include "imgui_impl_glfw.h"
@@ -23,13 +27,15 @@
 #include "box2d-lite/World.h"
 #include "box2d-lite/Body.h"
 #include "box2d-lite/Joint.h"
+#include "box2d-lite/DebugDraw.h"
+#include "box2d-lite/SceneBuilder.h"
+
+#include "raster.h"
 
 namespace
 {
 	GLFWwindow* mainWindow = NULL;
 
-	Body bodies[200];
-	Joint joints[100];
 	
 	Body* bomb = NULL;
 	Body* moter = NULL;			//모터 Body
@@ -39,17 +45,22 @@ namespace
 	int iterations = 10;
 	Vec2 gravity(0.0f, -10.0f);
 
-	int numBodies = 0;
-	int numJoints = 0;
-
 	int demoIndex = 0;
 
+	// Demos that keep adding bodies turn this on.
+	RainEmitter rain;
+	bool raining = false;
+
 	int width = 1280;
 	int height = 720;
 	float zoom = 10.0f;
 	float pan_y = 8.0f;
 
 	World world(gravity, iterations);
+	SceneBuilder scene(&world);
+
+	DebugDraw debugDraw;
+	GLuint debugBuffer = 0;
 	
 	//상태 저장 변수 추가
 	// (일시정지)
@@ -72,74 +83,52 @@ static void DrawText(int x, int y, const char* string)
 	ImGui::End();
 }
 
-static void DrawBody(Body* body)
+// Uploads the frame's debug geometry into one stream buffer and draws all
+// lines and then all points from it.
+static void DrawDebug(const DebugDraw& draw)
 {
-	Mat22 R(body->rotation);
-	Vec2 x = body->position;
-	Vec2 h = 0.5f * body->width;
-
-	Vec2 v1 = x + R * Vec2(-h.x, -h.y);
-	Vec2 v2 = x + R * Vec2( h.x, -h.y);
-	Vec2 v3 = x + R * Vec2( h.x,  h.y);
-	Vec2 v4 = x + R * Vec2(-h.x,  h.y);
-	if (body->isItExist == false)
-		glColor3f(1.3f, 0.7f, 0.3f);
-	else if (body == bomb)
-		glColor3f(0.4f, 0.9f, 0.4f);
-	else
-		glColor3f(0.8f, 0.8f, 0.9f);
-
-	glBegin(GL_LINE_LOOP);
-	glVertex2f(v1.x, v1.y);
-	glVertex2f(v2.x, v2.y);
-	glVertex2f(v3.x, v3.y);
-	glVertex2f(v4.x, v4.y);
-	glEnd();
-}
+	int numLines = (int)draw.lines.size();
+	int numPoints = (int)draw.points.size();
+	if (numLines + numPoints == 0)
+		return;
 
-static void DrawJoint(Joint* joint)
-{
-	Body* b1 = joint->body1;
-	Body* b2 = joint->body2;
+	if (debugBuffer == 0)
+		glGenBuffers(1, &debugBuffer);
+
+	GLsizeiptr lineBytes = numLines * sizeof(DebugVertex);
+	GLsizeiptr pointBytes = numPoints * sizeof(DebugVertex);
 
-	Mat22 R1(b1->rotation);
-	Mat22 R2(b2->rotation);
+	glBindBuffer(GL_ARRAY_BUFFER, debugBuffer);
+	glBufferData(GL_ARRAY_BUFFER, lineBytes + pointBytes, NULL, GL_STREAM_DRAW);
+	if (numLines > 0)
+		glBufferSubData(GL_ARRAY_BUFFER, 0, lineBytes, &draw.lines[0]);
+	if (numPoints > 0)
+		glBufferSubData(GL_ARRAY_BUFFER, lineBytes, pointBytes, &draw.points[0]);
 
-	Vec2 x1 = b1->position;
-	Vec2 p1 = x1 + R1 * joint->localAnchor1;
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+	glVertexPointer(2, GL_FLOAT, sizeof(DebugVertex), (const void*)offsetof(DebugVertex, position));
+	glColorPointer(3, GL_FLOAT, sizeof(DebugVertex), (const void*)offsetof(DebugVertex, color));
 
-	Vec2 x2 = b2->position;
-	Vec2 p2 = x2 + R2 * joint->localAnchor2;
+	glDrawArrays(GL_LINES, 0, numLines);
 
-	glColor3f(0.5f, 0.5f, 0.8f);
-	glBegin(GL_LINES);
-	glVertex2f(x1.x, x1.y);
-	glVertex2f(p1.x, p1.y);
-	glVertex2f(x2.x, x2.y);
-	glVertex2f(p2.x, p2.y);
-	glEnd();
+	glPointSize(4.0f);
+	glDrawArrays(GL_POINTS, numLines, numPoints);
+	glPointSize(1.0f);
+
+	glDisableClientState(GL_COLOR_ARRAY);
+	glDisableClientState(GL_VERTEX_ARRAY);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
 static void test()
 {
 
-	Body* tb = NULL;
-	tb = bodies + numBodies;
-	tb->Set(Vec2(1.0f, 1.0f), 50.0f);
-	world.World::Add(tb);
-	++numBodies;
-
-	tb->position.Set(-10.0f, 10.0f);
+	Body* tb = scene.AddBox(Vec2(-10.0f, 10.0f), Vec2(1.0f, 1.0f), 50.0f);
 	tb->velocity = Vec2(Random(20.0f, 50.0f), 0.0f);
 	tb->impulseLimit = 600;
 
-	Body* tb2 = NULL;
-	tb2 = bodies + numBodies;
-	tb2->Set(Vec2(1.0f, 1.0f), 50.0f);
-	world.Add(tb2);
-	++numBodies;
-
-	tb2->position.Set(10.0f, 10.0f);
+	Body* tb2 = scene.AddBox(Vec2(10.0f, 10.0f), Vec2(1.0f, 1.0f), 50.0f);
 	tb2->velocity = Vec2(Random(-50.0f, -0.01f), 0.0f);
 	tb2->impulseLimit = 600;
 }
@@ -148,18 +137,20 @@ static void LaunchBomb()
 {
 	if (!bomb)
 	{
-		bomb = bodies + numBodies;
-		bomb->Set(Vec2(1.0f, 1.0f), 50.0f);
+		bomb = scene.AddBox(Vec2(0.0f, 0.0f), Vec2(1.0f, 1.0f), 50.0f);
 		bomb->friction = 0.2f;
-		world.Add(bomb);
-		++numBodies;
 	}
 
-	bomb->position.Set(Random(-15.0f, 15.0f), 15.0f);
-	bomb->rotation = Random(-1.5f, 1.5f);
+	float x = Random(-15.0f, 15.0f);
+	float angle = Random(-1.5f, 1.5f);
+	bomb->SetTransform(Vec2(x, 15.0f), angle);
 	bomb->velocity = -1.5f * bomb->position;
 	bomb->angularVelocity = Random(-20.0f, 20.0f);
 	bomb->isItExist = true;
+
+	// A bomb that broke was removed from the world.
+	if (bomb->proxyId == DynamicTree::NULL_NODE)
+		world.Add(bomb);
 }
 
 //모터 생성 LaunchBomb()의 형식을 가져옴.
@@ -168,11 +159,9 @@ static void const Moter(bool oper)
 {
 	if (!moter)
 	{
-		moter = bodies + numBodies;
-		moter->Set(Vec2(1.0f, 1.0f), FLT_MAX);
+		moter = scene.AddBox(Vec2(0.0f, 0.0f), Vec2(1.0f, 1.0f), FLT_MAX);
+		moter->SetType(KINEMATIC_BODY);
 		moter->friction = 100.0f;
-		world.Add(moter);
-		++numBodies;
 	}
 	moter->position.Set((1.0f, 1.0f), 3.0f);
 
@@ -190,373 +179,168 @@ static void const Moter(bool oper)
 	float rotation = (moter->mass * moter->angularVelocity) * (1/timeStep);
 }
 
+// Drops a burst of random boxes onto the current demo.
+static void LaunchRain()
+{
+	scene.Rain(40, -12.0f, 12.0f, 18.0f, 0.2f, 0.6f, 2.0f);
+}
+
 // Single box
-static void Demo1(Body* b, Joint* j)
+static void Demo1()
 {
-	b->Set(Vec2(100.0f, 20.0f), FLT_MAX);
-	b->position.Set(0.0f, -0.5f * b->width.y);
-	world.Add(b);
-	++b; ++numBodies;
-
-	b->Set(Vec2(1.0f, 1.0f), 200.0f);
-	b->position.Set(0.0f, 4.0f);
-	world.Add(b);
+	scene.AddGround();
+
+	Body* b = scene.AddBox(Vec2(0.0f, 4.0f), Vec2(1.0f, 1.0f), 200.0f);
 	b->impulseLimit = 900.0f;
-	++b; ++numBodies;
 }
 
 // A simple pendulum
-static void Demo2(Body* b, Joint* j)
+static void Demo2()
 {
-	Body* b1 = b + 0;
-	b1->Set(Vec2(100.0f, 20.0f), FLT_MAX);
-	b1->friction = 0.2f;
-	b1->position.Set(0.0f, -0.5f * b1->width.y);
-	b1->rotation = 0.0f;
-	world.Add(b1);
-
-	Body* b2 = b + 1;
-	b2->Set(Vec2(1.0f, 1.0f), 100.0f);
-	b2->friction = 0.2f;
-	b2->position.Set(9.0f, 11.0f);
-	b2->rotation = 0.0f;
-	world.Add(b2);
-
-	numBodies += 2;
-
-	j->Set(b1, b2, Vec2(0.0f, 11.0f));
-	world.Add(j);
-
-	numJoints += 1;
+	Body* b1 = scene.AddGround();
+	Body* b2 = scene.AddBox(Vec2(9.0f, 11.0f), Vec2(1.0f, 1.0f), 100.0f);
+	scene.AddJoint(b1, b2, Vec2(0.0f, 11.0f));
 }
 
 // Varying friction coefficients
-static void Demo3(Body* b, Joint* j)
+static void Demo3()
 {
-	b->Set(Vec2(100.0f, 20.0f), FLT_MAX);
-	b->position.Set(0.0f, -0.5f * b->width.y);
-	world.Add(b);
-	++b; ++numBodies;
-
-	b->Set(Vec2(13.0f, 0.25f), FLT_MAX);
-	b->position.Set(-2.0f, 11.0f);
-	b->rotation = -0.25f;
-	world.Add(b);
-	++b; ++numBodies;
-
-	b->Set(Vec2(0.25f, 1.0f), FLT_MAX);
-	b->position.Set(5.25f, 9.5f);
-	world.Add(b);
-	++b; ++numBodies;
-
-	b->Set(Vec2(13.0f, 0.25f), FLT_MAX);
-	b->position.Set(2.0f, 7.0f);
-	b->rotation = 0.25f;
-	world.Add(b);
-	++b; ++numBodies;
-
-	b->Set(Vec2(0.25f, 1.0f), FLT_MAX);
-	b->position.Set(-5.25f, 5.5f);
-	world.Add(b);
-	++b; ++numBodies;
-
-	b->Set(Vec2(13.0f, 0.25f), FLT_MAX);
-	b->position.Set(-2.0f, 3.0f);
-	b->rotation = -0.25f;
-	world.Add(b);
-	++b; ++numBodies;
+	scene.AddGround();
+
+	scene.AddBox(Vec2(-2.0f, 11.0f), Vec2(13.0f, 0.25f), FLT_MAX, -0.25f);
+	scene.AddBox(Vec2(5.25f, 9.5f), Vec2(0.25f, 1.0f), FLT_MAX);
+	scene.AddBox(Vec2(2.0f, 7.0f), Vec2(13.0f, 0.25f), FLT_MAX, 0.25f);
+	scene.AddBox(Vec2(-5.25f, 5.5f), Vec2(0.25f, 1.0f), FLT_MAX);
+	scene.AddBox(Vec2(-2.0f, 3.0f), Vec2(13.0f, 0.25f), FLT_MAX, -0.25f);
 
 	float friction[5] = {0.75f, 0.5f, 0.35f, 0.1f, 0.0f};
 	for (int i = 0; i < 5; ++i)
 	{
-		b->Set(Vec2(0.5f, 0.5f), 25.0f);
+		Body* b = scene.AddBox(Vec2(-7.5f + 2.0f * i, 14.0f), Vec2(0.5f, 0.5f), 25.0f);
 		b->friction = friction[i];
-		b->position.Set(-7.5f + 2.0f * i, 14.0f);
-		world.Add(b);
-		++b; ++numBodies;
 	}
 }
 
 // A vertical stack
-static void Demo4(Body* b, Joint* j)
+static void Demo4()
 {
-	b->Set(Vec2(100.0f, 20.0f), FLT_MAX);
-	b->friction = 0.2f;
-	b->position.Set(0.0f, -0.5f * b->width.y);
-	b->rotation = 0.0f;
-	world.Add(b);
-	++b; ++numBodies;
+	scene.AddGround();
 
 	for (int i = 0; i < 10; ++i)
 	{
-		b->Set(Vec2(1.0f, 1.0f), 1.0f);
-		b->friction = 0.2f;
-		float x = Random(-0.1f, 0.1f);
-		b->position.Set(x, 0.51f + 1.05f * i);
-		world.Add(b);
-		++b; ++numBodies;
+		float x = scene.random.Next(-0.1f, 0.1f);
+		scene.AddBox(Vec2(x, 0.51f + 1.05f * i), Vec2(1.0f, 1.0f), 1.0f);
 	}
 }
 
 // A pyramid
-static void Demo5(Body* b, Joint* j)
+static void Demo5()
 {
-	b->Set(Vec2(100.0f, 20.0f), FLT_MAX);
-	b->friction = 0.2f;
-	b->position.Set(0.0f, -0.5f * b->width.y);
-	b->rotation = 0.0f;
-	world.Add(b);
-	++b; ++numBodies;
-
-	Vec2 x(-6.0f, 0.75f);
-	Vec2 y;
-
-	for (int i = 0; i < 12; ++i)
-	{
-		y = x;
-
-		for (int j = i; j < 12; ++j)
-		{
-			b->Set(Vec2(1.0f, 1.0f), 10.0f);
-			b->friction = 0.2f;
-			b->position = y;
-			world.Add(b);
-			++b; ++numBodies;
-
-			y += Vec2(1.125f, 0.0f);
-		}
-
-		//x += Vec2(0.5625f, 1.125f);
-		x += Vec2(0.5625f, 2.0f);
-	}
+	scene.AddGround();
+	scene.Pyramid(12, Vec2(0.1875f, 0.25f), Vec2(1.0f, 1.0f), 10.0f, Vec2(0.125f, 1.0f));
 }
 
 // A teeter
-static void Demo6(Body* b, Joint* j)
+static void Demo6()
 {
-	Body* b1 = b + 0;
-	b1->Set(Vec2(100.0f, 20.0f), FLT_MAX);
-	b1->position.Set(0.0f, -0.5f * b1->width.y);
-	world.Add(b1);
-
-	Body* b2 = b + 1;
-	b2->Set(Vec2(12.0f, 0.25f), 100.0f);
-	b2->position.Set(0.0f, 1.0f);
-	world.Add(b2);
-
-	Body* b3 = b + 2;
-	b3->Set(Vec2(0.5f, 0.5f), 25.0f);
-	b3->position.Set(-5.0f, 2.0f);
-	world.Add(b3);
-
-	Body* b4 = b + 3;
-	b4->Set(Vec2(0.5f, 0.5f), 25.0f);
-	b4->position.Set(-5.5f, 2.0f);
-	world.Add(b4);
-
-	Body* b5 = b + 4;
-	b5->Set(Vec2(1.0f, 1.0f), 100.0f);
-	b5->position.Set(5.5f, 15.0f);
-	world.Add(b5);
-
-	numBodies += 5;
+	Body* b1 = scene.AddGround();
+	Body* b2 = scene.AddBox(Vec2(0.0f, 1.0f), Vec2(12.0f, 0.25f), 100.0f);
+	scene.AddBox(Vec2(-5.0f, 2.0f), Vec2(0.5f, 0.5f), 25.0f);
+	scene.AddBox(Vec2(-5.5f, 2.0f), Vec2(0.5f, 0.5f), 25.0f);
+	scene.AddBox(Vec2(5.5f, 15.0f), Vec2(1.0f, 1.0f), 100.0f);
 
-	j->Set(b1, b2, Vec2(0.0f, 1.0f));
-	world.Add(j);
-
-	numJoints += 1;
+	scene.AddJoint(b1, b2, Vec2(0.0f, 1.0f));
 }
 
 // A suspension bridge
-static void Demo7(Body* b, Joint* j)
+static void Demo7()
 {
-	b->Set(Vec2(100.0f, 20.0f), FLT_MAX);
-	b->friction = 0.2f;
-	b->position.Set(0.0f, -0.5f * b->width.y);
-	b->rotation = 0.0f;
-	world.Add(b);
-	++b; ++numBodies;
+	Body* ground = scene.AddGround();
 
 	const int numPlanks = 15;
 	float mass = 50.0f;
 
+	Body* previous = ground;
 	for (int i = 0; i < numPlanks; ++i)
 	{
-		b->Set(Vec2(1.0f, 0.25f), mass);
-		b->friction = 0.2f;
-		b->position.Set(-8.5f + 1.25f * i, 5.0f);
-		world.Add(b);
-		++b; ++numBodies;
+		Body* b = scene.AddBox(Vec2(-8.5f + 1.25f * i, 5.0f), Vec2(1.0f, 0.25f), mass);
+		scene.AddSpringJoint(previous, b, Vec2(-9.125f + 1.25f * i, 5.0f), 2.0f, 0.7f, timeStep);
+		previous = b;
 	}
 
-	// Tuning
-	float frequencyHz = 2.0f;
-	float dampingRatio = 0.7f;
-
-	// frequency in radians
-	float omega = 2.0f * k_pi * frequencyHz;
-
-	// damping coefficient
-	float d = 2.0f * mass * dampingRatio * omega;
-
-	// spring stifness
-	float k = mass * omega * omega;
-
-	// magic formulas
-	float softness = 1.0f / (d + timeStep * k);
-	float biasFactor = timeStep * k / (d + timeStep * k);
-
-	for (int i = 0; i < numPlanks; ++i)
-	{
-		j->Set(bodies+i, bodies+i+1, Vec2(-9.125f + 1.25f * i, 5.0f));
-		j->softness = softness;
-		j->biasFactor = biasFactor;
-
-		world.Add(j);
-		++j; ++numJoints;
-	}
-
-	j->Set(bodies + numPlanks, bodies, Vec2(-9.125f + 1.25f * numPlanks, 5.0f));
-	j->softness = softness;
-	j->biasFactor = biasFactor;
-	world.Add(j);
-	++j; ++numJoints;
+	scene.AddSpringJoint(previous, ground, Vec2(-9.125f + 1.25f * numPlanks, 5.0f), 2.0f, 0.7f, timeStep);
 }
 
 // Dominos
-static void Demo8(Body* b, Joint* j)
+static void Demo8()
 {
-	Body* b1 = b;
-	b->Set(Vec2(100.0f, 20.0f), FLT_MAX);
-	b->position.Set(0.0f, -0.5f * b->width.y);
-	world.Add(b);
-	++b; ++numBodies;
+	Body* b1 = scene.AddGround();
 
-	b->Set(Vec2(12.0f, 0.5f), FLT_MAX);
-	b->position.Set(-1.5f, 10.0f);
-	world.Add(b);
-	++b; ++numBodies;
+	scene.AddBox(Vec2(-1.5f, 10.0f), Vec2(12.0f, 0.5f), FLT_MAX);
 
 	for (int i = 0; i < 10; ++i)
 	{
-		b->Set(Vec2(0.2f, 2.0f), 10.0f);
-		b->position.Set(-6.0f + 1.0f * i, 11.125f);
+		Body* b = scene.AddBox(Vec2(-6.0f + 1.0f * i, 11.125f), Vec2(0.2f, 2.0f), 10.0f);
 		b->friction = 0.1f;
-		world.Add(b);
-		++b; ++numBodies;
 	}
 
-	b->Set(Vec2(14.0f, 0.5f), FLT_MAX);
-	b->position.Set(1.0f, 6.0f);
-	b->rotation = 0.3f;
-	world.Add(b);
-	++b; ++numBodies;
-
-	Body* b2 = b;
-	b->Set(Vec2(0.5f, 3.0f), FLT_MAX);
-	b->position.Set(-7.0f, 4.0f);
-	world.Add(b);
-	++b; ++numBodies;
-
-	Body* b3 = b;
-	b->Set(Vec2(12.0f, 0.25f), 20.0f);
-	b->position.Set(-0.9f, 1.0f);
-	world.Add(b);
-	++b; ++numBodies;
-
-	j->Set(b1, b3, Vec2(-2.0f, 1.0f));
-	world.Add(j);
-	++j; ++numJoints;
-
-	Body* b4 = b;
-	b->Set(Vec2(0.5f, 0.5f), 10.0f);
-	b->position.Set(-10.0f, 15.0f);
-	world.Add(b);
-	++b; ++numBodies;
-
-	j->Set(b2, b4, Vec2(-7.0f, 15.0f));
-	world.Add(j);
-	++j; ++numJoints;
-
-	Body* b5 = b;
-	b->Set(Vec2(2.0f, 2.0f), 20.0f);
-	b->position.Set(6.0f, 2.5f);
-	b->friction = 0.1f;
-	world.Add(b);
-	++b; ++numBodies;
-
-	j->Set(b1, b5, Vec2(6.0f, 2.6f));
-	world.Add(j);
-	++j; ++numJoints;
-
-	Body* b6 = b;
-	b->Set(Vec2(2.0f, 0.2f), 10.0f);
-	b->position.Set(6.0f, 3.6f);
-	world.Add(b);
-	++b; ++numBodies;
-
-	j->Set(b5, b6, Vec2(7.0f, 3.5f));
-	world.Add(j);
-	++j; ++numJoints;
-}
-
-// A multi-pendulum
-static void Demo9(Body* b, Joint* j)
-{
-	b->Set(Vec2(100.0f, 20.0f), FLT_MAX);
-	b->friction = 0.2f;
-	b->position.Set(0.0f, -0.5f * b->width.y);
-	b->rotation = 0.0f;
-	world.Add(b);
-
-	Body * b1 = b;
-	++b;
-	++numBodies;
-
-	float mass = 10.0f;
+	scene.AddBox(Vec2(1.0f, 6.0f), Vec2(14.0f, 0.5f), FLT_MAX, 0.3f);
 
-	// Tuning
-	float frequencyHz = 4.0f;
-	float dampingRatio = 0.7f;
+	Body* b2 = scene.AddBox(Vec2(-7.0f, 4.0f), Vec2(0.5f, 3.0f), FLT_MAX);
+	Body* b3 = scene.AddBox(Vec2(-0.9f, 1.0f), Vec2(12.0f, 0.25f), 20.0f);
+	scene.AddJoint(b1, b3, Vec2(-2.0f, 1.0f));
 
-	// frequency in radians
-	float omega = 2.0f * k_pi * frequencyHz;
+	Body* b4 = scene.AddBox(Vec2(-10.0f, 15.0f), Vec2(0.5f, 0.5f), 10.0f);
+	scene.AddJoint(b2, b4, Vec2(-7.0f, 15.0f));
 
-	// damping coefficient
-	float d = 2.0f * mass * dampingRatio * omega;
+	Body* b5 = scene.AddBox(Vec2(6.0f, 2.5f), Vec2(2.0f, 2.0f), 20.0f);
+	b5->friction = 0.1f;
+	scene.AddJoint(b1, b5, Vec2(6.0f, 2.6f));
 
-	// spring stiffness
-	float k = mass * omega * omega;
+	Body* b6 = scene.AddBox(Vec2(6.0f, 3.6f), Vec2(2.0f, 0.2f), 10.0f);
+	scene.AddJoint(b5, b6, Vec2(7.0f, 3.5f));
+}
 
-	// magic formulas
-	float softness = 1.0f / (d + timeStep * k);
-	float biasFactor = timeStep * k / (d + timeStep * k);
+// A multi-pendulum
+static void Demo9()
+{
+	Body* b1 = scene.AddGround();
 
 	const float y = 12.0f;
 
 	for (int i = 0; i < 15; ++i)
 	{
-		Vec2 x(0.5f + i, y);
-		b->Set(Vec2(0.75f, 0.25f), mass);
-		b->friction = 0.2f;
-		b->position = x;
-		b->rotation = 0.0f;
-		world.Add(b);
-
-		j->Set(b1, b, Vec2(float(i), y));
-		j->softness = softness;
-		j->biasFactor = biasFactor;
-		world.Add(j);
-
+		Body* b = scene.AddBox(Vec2(0.5f + i, y), Vec2(0.75f, 0.25f), 10.0f);
+		scene.AddSpringJoint(b1, b, Vec2(float(i), y), 4.0f, 0.7f, timeStep);
 		b1 = b;
-		++b;
-		++numBodies;
-		++j;
-		++numJoints;
 	}
 }
 
-void (*demos[])(Body* b, Joint* j) = {Demo1, Demo2, Demo3, Demo4, Demo5, Demo6, Demo7, Demo8, Demo9};
+// Scene builder generators: dominoes, a chain, ragdolls and steady rain
+static void Demo10()
+{
+	scene.AddGround();
+
+	scene.Dominoes(12, Vec2(-14.0f, 0.0f), 0.8f, Vec2(0.15f, 1.5f), 5.0f);
+
+	Body* post = scene.AddBox(Vec2(4.0f, 6.0f), Vec2(0.5f, 12.0f), FLT_MAX);
+	scene.Chain(post, Vec2(4.25f, 11.5f), 10, Vec2(0.75f, 0.2f), 2.0f);
+
+	scene.Ragdolls(4, Vec2(-2.0f, 0.0f), 2.5f, 1.0f, 20.0f);
+
+	rain.rate = 10.0f;
+	rain.xMin = -14.0f;
+	rain.xMax = 14.0f;
+	rain.y = 18.0f;
+	rain.minSize = 0.3f;
+	rain.maxSize = 0.6f;
+	rain.mass = 1.0f;
+	rain.maxBodies = (int)scene.bodies.size() + 150;
+	rain.accumulator = 0.0f;
+	raining = true;
+}
+
+void (*demos[])() = {Demo1, Demo2, Demo3, Demo4, Demo5, Demo6, Demo7, Demo8, Demo9, Demo10};
 const char* demoStrings[] = {
 	"Demo 1: A Single Box",
 	"Demo 2: Simple Pendulum",
@@ -566,21 +350,19 @@ const char* demoStrings[] = {
 	"Demo 6: A Teeter",
 	"Demo 7: A Suspension Bridge",
 	"Demo 8: Dominos",
-	"Demo 9: Multi-pendulum"};
+	"Demo 9: Multi-pendulum",
+	"Demo 10: Dominoes, Chain, Ragdolls and Rain"};
 
 static void InitDemo(int index)
 {
-	
-	world.Clear();
-	numBodies = 0;
-	numJoints = 0;
+	scene.Clear();
 	bomb = NULL;
 	moter = NULL;		//Demo 변경 시 같이 초기화
+	raining = false;
 
 	demoIndex = index;
-	demos[index](bodies, joints);
+	demos[index]();
 }
-
 static void Keyboard(GLFWwindow* window, int key, int scancode, int action, int mods)
 {
 	if (action != GLFW_PRESS)
@@ -607,6 +389,10 @@ static void Keyboard(GLFWwindow* window, int key, int scancode, int action, int
 		InitDemo(key - GLFW_KEY_1);
 		break;
 
+	case '0':
+		InitDemo(9);
+		break;
+
 	case GLFW_KEY_A:
 		World::accumulateImpulses = !World::accumulateImpulses;
 		break;
@@ -619,6 +405,31 @@ static void Keyboard(GLFWwindow* window, int key, int scancode, int action, int
 		World::warmStarting = !World::warmStarting;
 		break;
 
+	case GLFW_KEY_C:
+		World::speculativeContacts = !World::speculativeContacts;
+		break;
+
+	case GLFW_KEY_O:
+		World::softStep = !World::softStep;
+		break;
+
+	case GLFW_KEY_B:
+		World::blockSolver = !World::blockSolver;
+		break;
+
+	case GLFW_KEY_L:
+		World::splitImpulse = !World::splitImpulse;
+		break;
+
+	case GLFW_KEY_G:
+		World::manifoldCaching = !World::manifoldCaching;
+		break;
+
+	case GLFW_KEY_H:
+		// Halve the simulation rate; drawing stays smooth by interpolation.
+		world.fixedTimeStep = world.fixedTimeStep == timeStep ? 2.0f * timeStep : timeStep;
+		break;
+
 	case GLFW_KEY_SPACE:
 		LaunchBomb();
 		break;
@@ -641,6 +452,10 @@ static void Keyboard(GLFWwindow* window, int key, int scancode, int action, int
 	case GLFW_KEY_T:
 		test();
 		break;
+
+	case GLFW_KEY_R:
+		LaunchRain();
+		break;
 	}
 }
 
@@ -666,8 +481,127 @@ static void Reshape(GLFWwindow*, int w, int h)
 	}
 }
 
-int main(int, char**)
+// Headless capture for visual regression checks. Steps the demos without a
+// window, rasterizes the debug geometry on the CPU and writes PPM frames,
+// or compares them with golden frames written by an earlier run:
+//   samples --headless [--demo N] [--steps N] [--every N] [--out DIR] [--golden DIR] [--tolerance N]
+static int RunHeadless(int argc, char** argv)
 {
+	int demo = 0;			// 1-10, 0 for all
+	int steps = 600;
+	int every = 1;
+	int tolerance = 0;
+	const char* outDir = NULL;
+	const char* goldenDir = NULL;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		bool hasValue = i + 1 < argc;
+		if (strcmp(argv[i], "--demo") == 0 && hasValue)
+			demo = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--steps") == 0 && hasValue)
+			steps = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--every") == 0 && hasValue)
+			every = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--tolerance") == 0 && hasValue)
+			tolerance = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--out") == 0 && hasValue)
+			outDir = argv[++i];
+		else if (strcmp(argv[i], "--golden") == 0 && hasValue)
+			goldenDir = argv[++i];
+	}
+
+	if (every < 1)
+		every = 1;
+
+	Framebuffer frame(width, height);
+	frame.SetView(zoom, pan_y);
+	Framebuffer golden(width, height);
+	WorldSnapshot snapshot;
+
+	int numDemos = sizeof(demos) / sizeof(demos[0]);
+	int failures = 0;
+	double rasterSeconds = 0.0;
+	int frames = 0;
+	char path[512];
+
+	for (int d = 0; d < numDemos; ++d)
+	{
+		if (demo != 0 && demo != d + 1)
+			continue;
+
+		// InitDemo reseeds the scene, so every run builds the same bodies.
+		InitDemo(d);
+
+		for (int step = 1; step <= steps; ++step)
+		{
+			if (raining)
+				rain.Update(scene, timeStep);
+			world.Step(timeStep);
+
+			if (step % every != 0)
+				continue;
+
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			world.WriteSnapshot(snapshot);
+			debugDraw.Clear();
+			debugDraw.highlight = bomb;
+			debugDraw.AddSnapshot(snapshot);
+			frame.Clear(Color(0.0f, 0.0f, 0.0f));
+			frame.Draw(debugDraw, 4);
+			rasterSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			++frames;
+
+			if (outDir != NULL)
+			{
+				sprintf(path, "%s/demo%d_%05d.ppm", outDir, d + 1, step);
+				if (!frame.WritePPM(path))
+				{
+					fprintf(stderr, "Failed to write %s\n", path);
+					return 1;
+				}
+			}
+
+			if (goldenDir != NULL)
+			{
+				sprintf(path, "%s/demo%d_%05d.ppm", goldenDir, d + 1, step);
+				if (!golden.ReadPPM(path))
+				{
+					printf("missing golden frame %s\n", path);
+					++failures;
+					continue;
+				}
+
+				int diff = frame.Diff(golden, tolerance);
+				if (diff < 0)
+				{
+					printf("demo %d step %d: frame is %dx%d but %s is %dx%d\n", d + 1, step, frame.width, frame.height, path, golden.width, golden.height);
+					++failures;
+				}
+				else if (diff != 0)
+				{
+					printf("demo %d step %d: %d pixels differ from %s\n", d + 1, step, diff, path);
+					++failures;
+				}
+			}
+		}
+	}
+
+	printf("%d frames, %.3f ms per frame to rasterize\n", frames, frames > 0 ? 1000.0 * rasterSeconds / frames : 0.0);
+
+	if (goldenDir != NULL)
+		printf("%d frames differ from the golden frames\n", failures);
+
+	return failures > 0 ? 1 : 0;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc > 1 && strcmp(argv[1], "--headless") == 0)
+	{
+		return RunHeadless(argc, argv);
+	}
+
 	glfwSetErrorCallback(glfwErrorCallback);
 
 	if (glfwInit() == 0)
@@ -729,8 +663,21 @@ int main(int, char**)
 
 	InitDemo(0);
 
+	world.fixedTimeStep = timeStep;
+	double lastTime = glfwGetTime();
+
 	while (!glfwWindowShouldClose(mainWindow))
 	{
+		double time = glfwGetTime();
+		float elapsed = float(time - lastTime);
+		lastTime = time;
+
+		// Step on the worker thread while this frame draws the last
+		// finished step. Steps are fixed; the drawn poses are interpolated.
+		// flag에 따른 일시정지 여부
+		world.AdvanceAsync(flag ? 0.0f : elapsed);
+		const WorldSnapshot& snapshot = world.GetSnapshot();
+
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
 		ImGui_ImplOpenGL2_NewFrame();
@@ -743,7 +690,7 @@ int main(int, char**)
 		ImGui::End();
 
 		DrawText(5, 5, demoStrings[demoIndex]);
-		DrawText(5, 35, "Keys: 1-9 Demos, Space to Launch the Bomb");
+		DrawText(5, 35, "Keys: 1-9, 0 Demos, Space to Launch the Bomb, R for Rain");
 
 		char buffer[64];
 		sprintf(buffer, "(A)ccumulation %s", World::accumulateImpulses ? "ON" : "OFF");
@@ -770,47 +717,44 @@ int main(int, char**)
 		sprintf(buffer, "(T)hrow 2 Body");
 		DrawText(5, 245, buffer);
 
-		glMatrixMode(GL_MODELVIEW);
-		glLoadIdentity();
+		sprintf(buffer, "Speculative (C)ontacts %s", World::speculativeContacts ? "ON" : "OFF");
+		DrawText(5, 275, buffer);
 
-		
-		// flag에 따른 일시정지 여부
-		if (flag == true)
-		{  
-			world.Step(0);
-		}
-		else
-		{
-			world.Step(timeStep);
-		}
+		sprintf(buffer, "S(o)ft Step %s (%d sub-steps)", World::softStep ? "ON" : "OFF", world.subSteps);
+		DrawText(5, 305, buffer);
 
-		
-		for (int i = 0; i < numBodies; ++i)
-			DrawBody(bodies + i);
+		sprintf(buffer, "(B)lock Solver %s", World::blockSolver ? "ON" : "OFF");
+		DrawText(5, 335, buffer);
 
-		for (int i = 0; i < numJoints; ++i)
-			DrawJoint(joints + i);
+		sprintf(buffer, "Sp(l)it Impulse %s", World::splitImpulse ? "ON" : "OFF");
+		DrawText(5, 365, buffer);
 
-		glPointSize(4.0f);
-		glColor3f(1.0f, 0.0f, 0.0f);
-		glBegin(GL_POINTS);
-		std::map<ArbiterKey, Arbiter>::const_iterator iter;
-		for (iter = world.arbiters.begin(); iter != world.arbiters.end(); ++iter)
-		{
-			const Arbiter& arbiter = iter->second;
-			for (int i = 0; i < arbiter.numContacts; ++i)
-			{
-				Vec2 p = arbiter.contacts[i].position;
-				glVertex2f(p.x, p.y);
-			}
-		}
-		glEnd();
-		glPointSize(1.0f);
+		sprintf(buffer, "Manifold Cachin(g) %s", World::manifoldCaching ? "ON" : "OFF");
+		DrawText(5, 395, buffer);
+
+		sprintf(buffer, "Iterations %d (+%d), %d position", snapshot.profile.iterations, snapshot.profile.extraIterations, snapshot.profile.positionIterations);
+		DrawText(5, 425, buffer);
+
+		sprintf(buffer, "Simulation %.0f (H)z", 1.0f / world.fixedTimeStep);
+		DrawText(5, 455, buffer);
+
+		glMatrixMode(GL_MODELVIEW);
+		glLoadIdentity();
+
+		debugDraw.Clear();
+		debugDraw.highlight = bomb;
+		debugDraw.AddSnapshot(snapshot);
+		DrawDebug(debugDraw);
 
 		ImGui::Render();
 		ImGui_ImplOpenGL2_RenderDrawData(ImGui::GetDrawData());
 
+		// Input below changes the world, so the step has to be done.
+		world.WaitStep();
 		glfwPollEvents();
+
+		if (raining && !flag)
+			rain.Update(scene, elapsed);
 		glfwSwapBuffers(mainWindow);
 	}
 
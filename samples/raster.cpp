@@ -0,0 +1,176 @@
+/*
+* Copyright (c) 2006-2009 Erin Catto http://www.gphysics.com
+*
+* Permission to use, copy, modify, distribute and sell this software
+* and its documentation for any purpose is hereby granted without fee,
+* provided that the above copyright notice appear in all copies.
+* Erin Catto makes no representations about the suitability
+* of this software for any purpose.
+* It is provided "as is" without express or implied warranty.
+*/
+
+#define _CRT_SECURE_NO_WARNINGS
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "raster.h"
+
+static unsigned char ToByte(float c)
+{
+	return (unsigned char)(Clamp(c, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+Framebuffer::Framebuffer(int width, int height) :
+	width(width), height(height), pixels(3 * width * height, 0), scale(1.0f), offset(0.0f, 0.0f)
+{
+}
+
+void Framebuffer::Clear(const Color& color)
+{
+	unsigned char r = ToByte(color.r), g = ToByte(color.g), b = ToByte(color.b);
+	for (int i = 0; i < width * height; ++i)
+	{
+		pixels[3 * i + 0] = r;
+		pixels[3 * i + 1] = g;
+		pixels[3 * i + 2] = b;
+	}
+}
+
+void Framebuffer::SetView(float zoom, float pan_y)
+{
+	// Pixel = (world - lower left) * scale, with y flipped below.
+	float aspect = float(width) / float(height);
+	float halfWidth = width >= height ? zoom * aspect : zoom;
+	scale = 0.5f * width / halfWidth;
+	offset.Set(-halfWidth, pan_y - 0.5f * height / scale);
+}
+
+static inline void Plot(Framebuffer* fb, int x, int y, unsigned char r, unsigned char g, unsigned char b)
+{
+	if (x < 0 || y < 0 || x >= fb->width || y >= fb->height)
+		return;
+
+	unsigned char* p = &fb->pixels[3 * ((fb->height - 1 - y) * fb->width + x)];
+	p[0] = r;
+	p[1] = g;
+	p[2] = b;
+}
+
+// Bresenham, clipped per pixel. Lines far outside the frame are rejected
+// up front so long off-screen edges (the ground) stay cheap.
+static void DrawLine(Framebuffer* fb, int x0, int y0, int x1, int y1, unsigned char r, unsigned char g, unsigned char b)
+{
+	if ((x0 < 0 && x1 < 0) || (y0 < 0 && y1 < 0) || (x0 >= fb->width && x1 >= fb->width) || (y0 >= fb->height && y1 >= fb->height))
+		return;
+
+	int dx = abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
+	int dy = -abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
+	int err = dx + dy;
+
+	for (;;)
+	{
+		Plot(fb, x0, y0, r, g, b);
+		if (x0 == x1 && y0 == y1)
+			break;
+
+		int e2 = 2 * err;
+		if (e2 >= dy)
+		{
+			err += dy;
+			x0 += sx;
+		}
+		if (e2 <= dx)
+		{
+			err += dx;
+			y0 += sy;
+		}
+	}
+}
+
+void Framebuffer::Draw(const DebugDraw& draw, int pointSize)
+{
+	// Keep coordinates in int range before Bresenham.
+	const float limit = 1.0e6f;
+
+	for (int i = 0; i + 1 < (int)draw.lines.size(); i += 2)
+	{
+		const DebugVertex& v1 = draw.lines[i];
+		const DebugVertex& v2 = draw.lines[i + 1];
+
+		Vec2 p1 = scale * (v1.position - offset);
+		Vec2 p2 = scale * (v2.position - offset);
+		p1.Set(Clamp(p1.x, -limit, limit), Clamp(p1.y, -limit, limit));
+		p2.Set(Clamp(p2.x, -limit, limit), Clamp(p2.y, -limit, limit));
+
+		DrawLine(this, (int)floorf(p1.x), (int)floorf(p1.y), (int)floorf(p2.x), (int)floorf(p2.y),
+				 ToByte(v1.color.r), ToByte(v1.color.g), ToByte(v1.color.b));
+	}
+
+	for (int i = 0; i < (int)draw.points.size(); ++i)
+	{
+		const DebugVertex& v = draw.points[i];
+		Vec2 p = scale * (v.position - offset);
+		if (p.x < -limit || p.x > limit || p.y < -limit || p.y > limit)
+			continue;
+
+		int x0 = (int)floorf(p.x) - pointSize / 2;
+		int y0 = (int)floorf(p.y) - pointSize / 2;
+		unsigned char r = ToByte(v.color.r), g = ToByte(v.color.g), b = ToByte(v.color.b);
+		for (int y = y0; y < y0 + pointSize; ++y)
+			for (int x = x0; x < x0 + pointSize; ++x)
+				Plot(this, x, y, r, g, b);
+	}
+}
+
+bool Framebuffer::WritePPM(const char* path) const
+{
+	FILE* file = fopen(path, "wb");
+	if (file == NULL)
+		return false;
+
+	fprintf(file, "P6\n%d %d\n255\n", width, height);
+	size_t written = fwrite(&pixels[0], 1, pixels.size(), file);
+	fclose(file);
+	return written == pixels.size();
+}
+
+bool Framebuffer::ReadPPM(const char* path)
+{
+	FILE* file = fopen(path, "rb");
+	if (file == NULL)
+		return false;
+
+	int w, h, maxValue;
+	if (fscanf(file, "P6 %d %d %d", &w, &h, &maxValue) != 3 || maxValue != 255 || w <= 0 || h <= 0)
+	{
+		fclose(file);
+		return false;
+	}
+
+	// Single whitespace byte before the binary data
+	fgetc(file);
+
+	width = w;
+	height = h;
+	pixels.resize(3 * w * h);
+	size_t read = fread(&pixels[0], 1, pixels.size(), file);
+	fclose(file);
+	return read == pixels.size();
+}
+
+int Framebuffer::Diff(const Framebuffer& other, int tolerance) const
+{
+	if (width != other.width || height != other.height)
+		return -1;
+
+	int count = 0;
+	for (int i = 0; i < width * height; ++i)
+	{
+		const unsigned char* a = &pixels[3 * i];
+		const unsigned char* b = &other.pixels[3 * i];
+		if (abs(a[0] - b[0]) > tolerance || abs(a[1] - b[1]) > tolerance || abs(a[2] - b[2]) > tolerance)
+			++count;
+	}
+
+	return count;
+}
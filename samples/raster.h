@@ -0,0 +1,49 @@
+/*
+* Copyright (c) 2006-2009 Erin Catto http://www.gphysics.com
+*
+* Permission to use, copy, modify, distribute and sell this software
+* and its documentation for any purpose is hereby granted without fee,
+* provided that the above copyright notice appear in all copies.
+* Erin Catto makes no representations about the suitability
+* of this software for any purpose.
+* It is provided "as is" without express or implied warranty.
+*/
+
+#ifndef RASTER_H
+#define RASTER_H
+
+#include <vector>
+#include "box2d-lite/DebugDraw.h"
+
+// In-memory RGB framebuffer with a minimal rasterizer for DebugDraw
+// buffers. Used by the headless mode of the samples to capture frames
+// without a GL context.
+struct Framebuffer
+{
+	Framebuffer(int width, int height);
+
+	void Clear(const Color& color);
+
+	// The view maps [-zoom * aspect, zoom * aspect] x [-zoom + pan_y, zoom + pan_y]
+	// onto the framebuffer, like the sample's glOrtho.
+	void SetView(float zoom, float pan_y);
+
+	// Lines are one pixel wide, points are pointSize pixels square.
+	void Draw(const DebugDraw& draw, int pointSize);
+
+	bool WritePPM(const char* path) const;
+	bool ReadPPM(const char* path);
+
+	// Number of pixels whose channels differ by more than tolerance, or -1
+	// if the sizes do not match.
+	int Diff(const Framebuffer& other, int tolerance) const;
+
+	int width, height;
+	std::vector<unsigned char> pixels;	// rows top to bottom, 3 bytes per pixel
+
+	// World to pixel transform
+	float scale;
+	Vec2 offset;
+};
+
+#endif
@@ -9,6 +9,8 @@
 * It is provided "as is" without express or implied warranty.
 */
 
+#include <stdio.h>
+
 #include "box2d-lite/Arbiter.h"
 #include "box2d-lite/Body.h"
 #include "box2d-lite/World.h"
@@ -16,9 +18,9 @@
 //Arbiter 헤더파일에 선언했던 변수를 불러옴
 bool Arbiter::flag2 = false;
 
-Arbiter::Arbiter(Body* b1, Body* b2)
+Arbiter::Arbiter(Body* b1, Body* b2, float margin, SeparatingAxis* separatingAxis)
 {
-	if (b1 < b2)
+	if (BodyPrecedes(b1, b2))
 	{
 		body1 = b1;
 		body2 = b2;
@@ -31,11 +33,17 @@ Arbiter::Arbiter(Body* b1, Body* b2)
 
 	//numContacts = Collide(contacts, body1, body2);
 	numContacts = 0; // NEW!
+	blockSolve = false;
+	compound = false;
+	visited = false;
+	solveDelta = 0.0f;
 	if (body1->isItExist && body2->isItExist) {
 		//printf("meow");
-		numContacts = Collide(contacts, body1, body2);
+		numContacts = Collide(contacts, body1, body2, margin, separatingAxis);
 	}
 
+	CacheRelativePose();
+
 
 	// flag2에 따른 빙판 
 	if(flag2 == true)
@@ -48,9 +56,37 @@ Arbiter::Arbiter(Body* b1, Body* b2)
 	}
 }
 
+// Arbiter for a manifold the batched narrowphase already computed. The
+// contacts must be ordered from key.body1 to key.body2.
+Arbiter::Arbiter(const ArbiterKey& key, const Contact* newContacts, int numNewContacts)
+{
+	body1 = key.body1;
+	body2 = key.body2;
+
+	numContacts = numNewContacts;
+	for (int i = 0; i < numContacts; ++i)
+		contacts[i] = newContacts[i];
+
+	blockSolve = false;
+	compound = false;
+	visited = false;
+	solveDelta = 0.0f;
+
+	CacheRelativePose();
+
+	if (flag2 == true)
+	{
+		friction = 0;
+	}
+	else
+	{
+		friction = sqrtf(body1->friction * body2->friction);
+	}
+}
+
 void Arbiter::Update(Contact* newContacts, int numNewContacts)
 {
-	Contact mergedContacts[2];
+	Contact mergedContacts[MAX_POINTS];
 
 	for (int i = 0; i < numNewContacts; ++i)
 	{
@@ -59,7 +95,7 @@ void Arbiter::Update(Contact* newContacts, int numNewContacts)
 		for (int j = 0; j < numContacts; ++j)
 		{
 			Contact* cOld = contacts + j;
-			if (cNew->feature.value == cOld->feature.value)
+			if (cNew->feature.value == cOld->feature.value && cNew->childPair == cOld->childPair)
 			{
 				k = j;
 				break;
@@ -75,7 +111,6 @@ void Arbiter::Update(Contact* newContacts, int numNewContacts)
 			{
 				c->Pn = cOld->Pn;
 				c->Pt = cOld->Pt;
-				c->Pnb = cOld->Pnb;
 			}
 			else
 			{
@@ -94,6 +129,61 @@ void Arbiter::Update(Contact* newContacts, int numNewContacts)
 		contacts[i] = mergedContacts[i];
 
 	numContacts = numNewContacts;
+
+	CacheRelativePose();
+}
+
+// Remember the relative pose of the bodies for the current manifold.
+void Arbiter::CacheRelativePose()
+{
+	Mat22 Rot1(body1->rot), Rot2(body2->rot);
+	Vec2 d = body2->position - body1->position;
+
+	relativePosition1 = Rot1.Transpose() * d;
+	relativePosition2 = Rot2.Transpose() * -d;
+	relativeRotation = body2->rotation - body1->rotation;
+
+	if (numContacts > 0)
+		localNormal = Rot1.Transpose() * contacts[0].normal;
+}
+
+// Reuse the manifold while no point of one body has moved more than the
+// tolerance relative to the other since Collide() last ran. A point the
+// manifold is missing can then be at most that deep, which is less than the
+// allowed penetration. The contacts are rebuilt from their local anchors.
+// Returns false if the narrowphase must run again.
+bool Arbiter::RefreshContacts()
+{
+	const float k_manifoldTolerance = 0.005f;
+
+	if (numContacts == 0 || body1->isItExist == false || body2->isItExist == false)
+		return false;
+
+	Mat22 Rot1(body1->rot), Rot2(body2->rot);
+	Vec2 d = body2->position - body1->position;
+
+	// Bound the motion of body2's points in body1's frame and the other way
+	// around. The smaller body gives the tighter bound.
+	float dRot = Abs(body2->rotation - body1->rotation - relativeRotation);
+	float drift1 = (Rot1.Transpose() * d - relativePosition1).Length() + dRot * 0.5f * body2->width.Length();
+	float drift2 = (Rot2.Transpose() * -d - relativePosition2).Length() + dRot * 0.5f * body1->width.Length();
+	if (Min(drift1, drift2) > k_manifoldTolerance)
+		return false;
+
+	Vec2 normal = Rot1 * localNormal;
+
+	for (int i = 0; i < numContacts; ++i)
+	{
+		Contact* c = contacts + i;
+		Vec2 p1 = body1->position + Rot1 * c->localAnchor1;
+		Vec2 p2 = body2->position + Rot2 * c->localAnchor2;
+
+		c->normal = normal;
+		c->separation = Dot(p2 - p1, normal);
+		c->position = 0.5f * (p1 + p2);
+	}
+
+	return true;
 }
 
 
@@ -123,7 +213,23 @@ void Arbiter::PreStep(float inv_dt)
 		kTangent += body1->invI * (Dot(r1, r1) - rt1 * rt1) + body2->invI * (Dot(r2, r2) - rt2 * rt2);
 		c->massTangent = 1.0f /  kTangent;
 
-		c->bias = -k_biasFactor * inv_dt * Min(0.0f, c->separation + k_allowedPenetration);
+		if (c->separation > 0.0f)
+		{
+			// Speculative contact: allow the approach speed that just closes the gap.
+			c->bias = -inv_dt * c->separation;
+			c->positionBias = c->bias;
+		}
+		else if (World::splitImpulse)
+		{
+			// The penetration is removed by the position pass instead.
+			c->bias = 0.0f;
+			c->positionBias = -k_biasFactor * inv_dt * Min(0.0f, c->separation + k_allowedPenetration);
+		}
+		else
+		{
+			c->bias = -k_biasFactor * inv_dt * Min(0.0f, c->separation + k_allowedPenetration);
+			c->positionBias = 0.0f;
+		}
 
 		if (World::accumulateImpulses)
 		{
@@ -136,16 +242,63 @@ void Arbiter::PreStep(float inv_dt)
 			body2->velocity += body2->invMass * P;
 			body2->angularVelocity += body2->invI * Cross(r2, P);
 		}
+
+		// The position pass is not warm started. Replaying last step's push
+		// would keep separating bodies that are no longer penetrating.
+		c->Pnb = 0.0f;
+	}
+
+	// Set up the 2x2 block solver for two-point manifolds.
+	blockSolve = false;
+	if (numContacts == 2 && !compound && World::blockSolver && World::accumulateImpulses)
+	{
+		// Keep the condition number of K below this.
+		const float k_maxConditionNumber = 1000.0f;
+
+		Contact* c1 = contacts + 0;
+		Contact* c2 = contacts + 1;
+		Vec2 normal = c1->normal;
+
+		float rn11 = Cross(c1->position - body1->position, normal);
+		float rn12 = Cross(c1->position - body2->position, normal);
+		float rn21 = Cross(c2->position - body1->position, normal);
+		float rn22 = Cross(c2->position - body2->position, normal);
+
+		float invMassSum = body1->invMass + body2->invMass;
+		float k11 = invMassSum + body1->invI * rn11 * rn11 + body2->invI * rn12 * rn12;
+		float k22 = invMassSum + body1->invI * rn21 * rn21 + body2->invI * rn22 * rn22;
+		float k12 = invMassSum + body1->invI * rn11 * rn21 + body2->invI * rn12 * rn22;
+
+		if (k11 * k11 < k_maxConditionNumber * (k11 * k22 - k12 * k12))
+		{
+			K.col1.Set(k11, k12);
+			K.col2.Set(k12, k22);
+			normalMass = K.Invert();
+			blockSolve = true;
+		}
+		// Otherwise the points are nearly redundant and the sequential solver is used.
 	}
 }
 
+// Returns the largest relative velocity change caused by this pass, which
+// the world uses to detect convergence. Static and kinematic bodies have zero
+// inverse mass, so their velocity is only read here.
 //void Arbiter::ApplyImpulse()
-void Arbiter::ApplyImpulse(Body** deadBodyStoragePtr, int numStorage)
+float Arbiter::ApplyImpulse(Body** deadBodyStoragePtr, int numStorage)
 {
 	//printf("debug - ApplyImpulse \n");
 	Body* b1 = body1;
 	Body* b2 = body2;
 
+	if (blockSolve)
+	{
+		float delta = ApplyBlockImpulse();
+		CheckImpulseLimit(deadBodyStoragePtr, numStorage);
+		return delta;
+	}
+
+	float delta = 0.0f;
+
 	for (int i = 0; i < numContacts; ++i)
 	{
 		Contact* c = contacts + i;
@@ -155,7 +308,8 @@ void Arbiter::ApplyImpulse(Body** deadBodyStoragePtr, int numStorage)
 		// Relative velocity at contact
 		Vec2 dv = b2->velocity + Cross(b2->angularVelocity, c->r2) - b1->velocity - Cross(b1->angularVelocity, c->r1);
 
-		// Compute normal impulse
+		// Compute normal impulse. For a speculative contact the bias is negative,
+		// so an impulse only appears if the bodies would close the gap this step.
 		float vn = Dot(dv, c->normal);
 
 		float dPn = c->massNormal * (-vn + c->bias);
@@ -172,6 +326,8 @@ void Arbiter::ApplyImpulse(Body** deadBodyStoragePtr, int numStorage)
 			dPn = Max(dPn, 0.0f);
 		}
 
+		delta = Max(delta, Abs(dPn) / c->massNormal);
+
 		// Apply contact impulse
 		Vec2 Pn = dPn * c->normal;
 
@@ -204,6 +360,8 @@ void Arbiter::ApplyImpulse(Body** deadBodyStoragePtr, int numStorage)
 			dPt = Clamp(dPt, -maxPt, maxPt);
 		}
 
+		delta = Max(delta, Abs(dPt) / c->massTangent);
+
 		// Apply contact impulse
 		Vec2 Pt = dPt * tangent;
 
@@ -213,13 +371,212 @@ void Arbiter::ApplyImpulse(Body** deadBodyStoragePtr, int numStorage)
 		b2->velocity += b2->invMass * Pt;
 		b2->angularVelocity += b2->invI * Cross(c->r2, Pt);
 	}
-	
+
+	CheckImpulseLimit(deadBodyStoragePtr, numStorage);
+	return delta;
+}
+
+// Solve both normal impulses of a two-point manifold together as a 2x2 LCP.
+// The four cases of the complementarity conditions are tried in order:
+//
+// vn = K * x + b, vn >= 0, x >= 0, vn_i * x_i = 0
+//
+// where x is the accumulated impulse and b the velocity before the solve.
+// a is the accumulated impulse before the solve.
+static Vec2 SolveBlock(const Mat22& K, const Mat22& normalMass, float massNormal1, float massNormal2, const Vec2& a, const Vec2& b)
+{
+	Vec2 x;
+	for (;;)
+	{
+		// Case 1: both points active
+		x = -(normalMass * b);
+		if (x.x >= 0.0f && x.y >= 0.0f)
+			break;
+
+		// Case 2: only the first point active
+		x.Set(-massNormal1 * b.x, 0.0f);
+		float vn2 = K.col1.y * x.x + b.y;
+		if (x.x >= 0.0f && vn2 >= 0.0f)
+			break;
+
+		// Case 3: only the second point active
+		x.Set(0.0f, -massNormal2 * b.y);
+		float vn1 = K.col2.x * x.y + b.x;
+		if (x.y >= 0.0f && vn1 >= 0.0f)
+			break;
+
+		// Case 4: both points separating
+		x.Set(0.0f, 0.0f);
+		if (b.x >= 0.0f && b.y >= 0.0f)
+			break;
+
+		// No solution, keep the old impulses. This only happens from round-off.
+		x = a;
+		break;
+	}
+
+	return x;
+}
+
+float Arbiter::ApplyBlockImpulse()
+{
+	Body* b1 = body1;
+	Body* b2 = body2;
+
+	Contact* c1 = contacts + 0;
+	Contact* c2 = contacts + 1;
+	Vec2 normal = c1->normal;
+
+	c1->r1 = c1->position - b1->position;
+	c1->r2 = c1->position - b2->position;
+	c2->r1 = c2->position - b1->position;
+	c2->r2 = c2->position - b2->position;
+
+	Vec2 dv1 = b2->velocity + Cross(b2->angularVelocity, c1->r2) - b1->velocity - Cross(b1->angularVelocity, c1->r1);
+	Vec2 dv2 = b2->velocity + Cross(b2->angularVelocity, c2->r2) - b1->velocity - Cross(b1->angularVelocity, c2->r1);
+
+	// Velocity error relative to the bias, with the accumulated impulse removed.
+	Vec2 a(c1->Pn, c2->Pn);
+	Vec2 b(Dot(dv1, normal) - c1->bias, Dot(dv2, normal) - c2->bias);
+	b -= K * a;
+
+	Vec2 x = SolveBlock(K, normalMass, c1->massNormal, c2->massNormal, a, b);
+
+	Vec2 d = x - a;
+	Vec2 P1 = d.x * normal;
+	Vec2 P2 = d.y * normal;
+
+	b1->velocity -= b1->invMass * (P1 + P2);
+	b1->angularVelocity -= b1->invI * (Cross(c1->r1, P1) + Cross(c2->r1, P2));
+
+	b2->velocity += b2->invMass * (P1 + P2);
+	b2->angularVelocity += b2->invI * (Cross(c1->r2, P1) + Cross(c2->r2, P2));
+
+	c1->Pn = x.x;
+	c2->Pn = x.y;
+
+	float delta = Max(Abs(d.x) / c1->massNormal, Abs(d.y) / c2->massNormal);
+
+	// Friction, one point at a time with the new normal impulses.
+	Vec2 tangent = Cross(normal, 1.0f);
+	for (int i = 0; i < 2; ++i)
+	{
+		Contact* c = contacts + i;
+
+		Vec2 dv = b2->velocity + Cross(b2->angularVelocity, c->r2) - b1->velocity - Cross(b1->angularVelocity, c->r1);
+		float vt = Dot(dv, tangent);
+		float dPt = c->massTangent * (-vt);
+
+		float maxPt = friction * c->Pn;
+		float oldTangentImpulse = c->Pt;
+		c->Pt = Clamp(oldTangentImpulse + dPt, -maxPt, maxPt);
+		dPt = c->Pt - oldTangentImpulse;
+
+		delta = Max(delta, Abs(dPt) / c->massTangent);
+
+		Vec2 Pt = dPt * tangent;
+
+		b1->velocity -= b1->invMass * Pt;
+		b1->angularVelocity -= b1->invI * Cross(c->r1, Pt);
+
+		b2->velocity += b2->invMass * Pt;
+		b2->angularVelocity += b2->invI * Cross(c->r2, Pt);
+	}
+
+	return delta;
+}
+
+// Same normal solve as ApplyImpulse on the pseudo velocities, with Pnb as
+// the accumulated impulse. There is no friction and no warm starting: the
+// pseudo velocities start from zero every step.
+float Arbiter::ApplyPositionImpulse()
+{
+	Body* b1 = body1;
+	Body* b2 = body2;
+
+	if (blockSolve)
+	{
+		Contact* c1 = contacts + 0;
+		Contact* c2 = contacts + 1;
+		Vec2 normal = c1->normal;
+
+		Vec2 r11 = c1->position - b1->position;
+		Vec2 r12 = c1->position - b2->position;
+		Vec2 r21 = c2->position - b1->position;
+		Vec2 r22 = c2->position - b2->position;
+
+		Vec2 dv1 = b2->biasVelocity + Cross(b2->biasAngularVelocity, r12) - b1->biasVelocity - Cross(b1->biasAngularVelocity, r11);
+		Vec2 dv2 = b2->biasVelocity + Cross(b2->biasAngularVelocity, r22) - b1->biasVelocity - Cross(b1->biasAngularVelocity, r21);
+
+		Vec2 a(c1->Pnb, c2->Pnb);
+		Vec2 b(Dot(dv1, normal) - c1->positionBias, Dot(dv2, normal) - c2->positionBias);
+		b -= K * a;
+
+		Vec2 x = SolveBlock(K, normalMass, c1->massNormal, c2->massNormal, a, b);
+
+		Vec2 d = x - a;
+		Vec2 P1 = d.x * normal;
+		Vec2 P2 = d.y * normal;
+
+		b1->biasVelocity -= b1->invMass * (P1 + P2);
+		b1->biasAngularVelocity -= b1->invI * (Cross(r11, P1) + Cross(r21, P2));
+
+		b2->biasVelocity += b2->invMass * (P1 + P2);
+		b2->biasAngularVelocity += b2->invI * (Cross(r12, P1) + Cross(r22, P2));
+
+		c1->Pnb = x.x;
+		c2->Pnb = x.y;
+
+		return Max(Abs(d.x) / c1->massNormal, Abs(d.y) / c2->massNormal);
+	}
+
+	float delta = 0.0f;
+
+	for (int i = 0; i < numContacts; ++i)
+	{
+		Contact* c = contacts + i;
+
+		// Contacts within the slop still take part, so a push on one
+		// point does not rotate the body through another.
+		Vec2 r1 = c->position - b1->position;
+		Vec2 r2 = c->position - b2->position;
+
+		Vec2 dv = b2->biasVelocity + Cross(b2->biasAngularVelocity, r2) - b1->biasVelocity - Cross(b1->biasAngularVelocity, r1);
+		float vn = Dot(dv, c->normal);
+
+		float dPnb = c->massNormal * (-vn + c->positionBias);
+
+		float Pnb0 = c->Pnb;
+		c->Pnb = Max(Pnb0 + dPnb, 0.0f);
+		dPnb = c->Pnb - Pnb0;
+
+		delta = Max(delta, Abs(dPnb) / c->massNormal);
+
+		Vec2 Pb = dPnb * c->normal;
+
+		b1->biasVelocity -= b1->invMass * Pb;
+		b1->biasAngularVelocity -= b1->invI * Cross(r1, Pb);
+
+		b2->biasVelocity += b2->invMass * Pb;
+		b2->biasAngularVelocity += b2->invI * Cross(r2, Pb);
+	}
+
+	return delta;
+}
+
+void Arbiter::CheckImpulseLimit(Body** deadBodyStoragePtr, int numStorage)
+{
+	// Strongest point of the manifold, merged compound points included
+	float maxPn = 0.0f;
+	for (int i = 0; i < numContacts; ++i)
+		maxPn = Max(maxPn, contacts[i].Pn);
+
 	for (int i = 0; i < 2; i++) {
 		Body* targetBody[2] = { body1, body2 };
 
-		if (targetBody[i]->isBreakAble == false) continue;
-		if (targetBody[i]->impulseLimit < Max(contacts[0].Pn,contacts[1].Pn)) {
-			printf("[Debug] OverImpulse detected : %f \n", Max(contacts[0].Pn, contacts[1].Pn));
+		if (targetBody[i]->isBreakAble == false || targetBody[i]->type != DYNAMIC_BODY) continue;
+		if (targetBody[i]->impulseLimit < maxPn) {
+			printf("[Debug] OverImpulse detected : %f \n", maxPn);
 
 			//World::KillBody(targetBody[i]);
 
@@ -249,5 +606,142 @@ void Arbiter::ApplyImpulse(Body** deadBodyStoragePtr, int numStorage)
 			}
 		}
 	}
+}
+
+// Soft constraint coefficients. The spring is integrated implicitly over the
+// sub-step h, so it stays stable for any stiffness.
+Softness::Softness(float hertz, float dampingRatio, float h)
+{
+	if (hertz == 0.0f)
+	{
+		biasRate = 0.0f;
+		massScale = 1.0f;
+		impulseScale = 0.0f;
+		return;
+	}
+
+	float omega = 2.0f * k_pi * hertz;
+	float a1 = 2.0f * dampingRatio + h * omega;
+	float a2 = h * omega * a1;
+	float a3 = 1.0f / (1.0f + a2);
+	biasRate = omega / a1;
+	massScale = a2 * a3;
+	impulseScale = a3;
+}
+
+// Called once per step. The anchors are frozen for all sub-steps and the
+// separation is tracked through the local anchors.
+void Arbiter::PreStepSoft()
+{
+	for (int i = 0; i < numContacts; ++i)
+	{
+		Contact* c = contacts + i;
+
+		c->r1 = c->position - body1->position;
+		c->r2 = c->position - body2->position;
+
+		float rn1 = Dot(c->r1, c->normal);
+		float rn2 = Dot(c->r2, c->normal);
+		float kNormal = body1->invMass + body2->invMass;
+		kNormal += body1->invI * (Dot(c->r1, c->r1) - rn1 * rn1) + body2->invI * (Dot(c->r2, c->r2) - rn2 * rn2);
+		c->massNormal = 1.0f / kNormal;
+
+		Vec2 tangent = Cross(c->normal, 1.0f);
+		float rt1 = Dot(c->r1, tangent);
+		float rt2 = Dot(c->r2, tangent);
+		float kTangent = body1->invMass + body2->invMass;
+		kTangent += body1->invI * (Dot(c->r1, c->r1) - rt1 * rt1) + body2->invI * (Dot(c->r2, c->r2) - rt2 * rt2);
+		c->massTangent = 1.0f / kTangent;
+	}
+}
 
+// Called at the start of every sub-step.
+void Arbiter::WarmStart()
+{
+	for (int i = 0; i < numContacts; ++i)
+	{
+		Contact* c = contacts + i;
+		Vec2 tangent = Cross(c->normal, 1.0f);
+		Vec2 P = c->Pn * c->normal + c->Pt * tangent;
+
+		body1->velocity -= body1->invMass * P;
+		body1->angularVelocity -= body1->invI * Cross(c->r1, P);
+
+		body2->velocity += body2->invMass * P;
+		body2->angularVelocity += body2->invI * Cross(c->r2, P);
+	}
+}
+
+// Soft contact solve. With useBias the penetration is pushed out through a
+// damped spring; the relax pass (useBias = false) then removes the velocity
+// the spring added, so no energy is injected into resting contacts.
+void Arbiter::ApplySoftImpulse(float inv_h, const Softness& soft, bool useBias)
+{
+	const float k_maxPushoutVelocity = 3.0f;
+
+	Body* b1 = body1;
+	Body* b2 = body2;
+
+	Mat22 Rot1(b1->rot), Rot2(b2->rot);
+
+	for (int i = 0; i < numContacts; ++i)
+	{
+		Contact* c = contacts + i;
+
+		// Current separation from the anchors
+		Vec2 p1 = b1->position + Rot1 * c->localAnchor1;
+		Vec2 p2 = b2->position + Rot2 * c->localAnchor2;
+		float s = Dot(p2 - p1, c->normal);
+
+		float bias = 0.0f;
+		float massScale = 1.0f;
+		float impulseScale = 0.0f;
+		if (s > 0.0f)
+		{
+			// Speculative
+			bias = -inv_h * s;
+		}
+		else if (useBias)
+		{
+			bias = Min(-soft.biasRate * s, k_maxPushoutVelocity);
+			massScale = soft.massScale;
+			impulseScale = soft.impulseScale;
+		}
+
+		Vec2 dv = b2->velocity + Cross(b2->angularVelocity, c->r2) - b1->velocity - Cross(b1->angularVelocity, c->r1);
+		float vn = Dot(dv, c->normal);
+
+		float dPn = massScale * c->massNormal * (-vn + bias) - impulseScale * c->Pn;
+		float Pn0 = c->Pn;
+		c->Pn = Max(Pn0 + dPn, 0.0f);
+		dPn = c->Pn - Pn0;
+
+		Vec2 Pn = dPn * c->normal;
+
+		b1->velocity -= b1->invMass * Pn;
+		b1->angularVelocity -= b1->invI * Cross(c->r1, Pn);
+
+		b2->velocity += b2->invMass * Pn;
+		b2->angularVelocity += b2->invI * Cross(c->r2, Pn);
+
+		// Friction
+		dv = b2->velocity + Cross(b2->angularVelocity, c->r2) - b1->velocity - Cross(b1->angularVelocity, c->r1);
+
+		Vec2 tangent = Cross(c->normal, 1.0f);
+		float vt = Dot(dv, tangent);
+		float dPt = c->massTangent * (-vt);
+
+		float maxPt = friction * c->Pn;
+		float Pt0 = c->Pt;
+		c->Pt = Clamp(Pt0 + dPt, -maxPt, maxPt);
+		dPt = c->Pt - Pt0;
+
+		Vec2 Pt = dPt * tangent;
+
+		b1->velocity -= b1->invMass * Pt;
+		b1->angularVelocity -= b1->invI * Cross(c->r1, Pt);
+
+		b2->velocity += b2->invMass * Pt;
+		b2->angularVelocity += b2->invI * Cross(c->r2, Pt);
+	}
 }
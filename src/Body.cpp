@@ -15,13 +15,24 @@ Body::Body()
 {
 	position.Set(0.0f, 0.0f);
 	rotation = 0.0f;
+	rot = Rot();
+	rotAngle = 0.0f;
+	previousPosition.Set(0.0f, 0.0f);
+	previousRotation = 0.0f;
 	velocity.Set(0.0f, 0.0f);
 	angularVelocity = 0.0f;
+	biasVelocity.Set(0.0f, 0.0f);
+	biasAngularVelocity = 0.0f;
 	force.Set(0.0f, 0.0f);
 	torque = 0.0f;
 	friction = 0.2f;
 
 	width.Set(1.0f, 1.0f);
+	type = STATIC_BODY;
+	categoryBits = 0x0001;
+	maskBits = 0xFFFFFFFF;
+	groupIndex = 0;
+	isSensor = false;
 	mass = FLT_MAX;
 	invMass = 0.0f;
 	I = FLT_MAX;
@@ -29,24 +40,31 @@ Body::Body()
 	isBreakAble = true;
 	impulseLimit = 400.0f;
 	isItExist = true;
+	proxyId = -1;
 }
 
 void Body::Set(const Vec2& w, float m)
 {
 	position.Set(0.0f, 0.0f);
 	rotation = 0.0f;
+	rot = Rot();
+	rotAngle = 0.0f;
 	velocity.Set(0.0f, 0.0f);
 	angularVelocity = 0.0f;
+	biasVelocity.Set(0.0f, 0.0f);
+	biasAngularVelocity = 0.0f;
 	force.Set(0.0f, 0.0f);
 	torque = 0.0f;
 	friction = 0.2f;
 
 	width = w;
+	boxes.clear();
 	mass = m;
 	impulseLimit = 400.0f;
 	isItExist = true;
 	if (mass < FLT_MAX)
 	{
+		type = DYNAMIC_BODY;
 		invMass = 1.0f / mass;
 		I = mass * (width.x * width.x + width.y * width.y) / 12.0f;
 		invI = 1.0f / I;
@@ -55,6 +73,7 @@ void Body::Set(const Vec2& w, float m)
 	{
 		//impulseLimit = 3000.0f;
 		
+		type = STATIC_BODY;
 		invMass = 0.0f;
 		I = FLT_MAX;
 		invI = 0.0f;
@@ -62,6 +81,77 @@ void Body::Set(const Vec2& w, float m)
 	}
 }
 
+Vec2 Body::SetCompound(const BoxShape* shapes, int count, float m)
+{
+	assert(count > 0);
+	std::vector<BoxShape> compound(shapes, shapes + count);
+
+	float area = 0.0f;
+	Vec2 centroid(0.0f, 0.0f);
+	for (int i = 0; i < count; ++i)
+	{
+		BoxShape& box = compound[i];
+		box.rot = Rot(box.rotation);
+		box.proxyId = -1;
+
+		float boxArea = box.width.x * box.width.y;
+		area += boxArea;
+		centroid += boxArea * box.position;
+	}
+
+	// The centroid and inertia are area weighted.
+	assert(area > 0.0f);
+	centroid *= 1.0f / area;
+
+	// Inertia of each box about its own center, moved to the centroid.
+	float unitInertia = 0.0f;
+	Vec2 extent(0.0f, 0.0f);
+	for (int i = 0; i < count; ++i)
+	{
+		BoxShape& box = compound[i];
+		box.position -= centroid;
+
+		float boxArea = box.width.x * box.width.y;
+		unitInertia += boxArea * ((box.width.x * box.width.x + box.width.y * box.width.y) / 12.0f + Dot(box.position, box.position));
+
+		Vec2 h = Abs(Mat22(box.rot)) * (0.5f * box.width);
+		extent.x = Max(extent.x, Abs(box.position.x) + h.x);
+		extent.y = Max(extent.y, Abs(box.position.y) + h.y);
+	}
+
+	Set(2.0f * extent, m);
+	boxes.swap(compound);
+
+	if (mass < FLT_MAX)
+	{
+		I = mass * unitInertia / area;
+		invI = 1.0f / I;
+	}
+
+	return centroid;
+}
+
+void Body::SetType(BodyType t)
+{
+	type = t;
+	if (type == DYNAMIC_BODY && mass < FLT_MAX)
+	{
+		invMass = 1.0f / mass;
+		invI = 1.0f / I;
+	}
+	else
+	{
+		invMass = 0.0f;
+		invI = 0.0f;
+	}
+
+	if (type == STATIC_BODY)
+	{
+		velocity.Set(0.0f, 0.0f);
+		angularVelocity = 0.0f;
+	}
+}
+
 void Body::setPosition2(Vec2& v) {
 	position = v;
 }
\ No newline at end of file
@@ -9,6 +9,14 @@
 * It is provided "as is" without express or implied warranty.
 */
 #include <iostream>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BOX2D_SIMD_SSE 1
+#else
+#define BOX2D_SIMD_SSE 0
+#endif
+
 #include "box2d-lite/Arbiter.h"
 #include "box2d-lite/Body.h"
 
@@ -24,14 +32,6 @@
 //   v3 ------ v4
 //        e3
 
-enum Axis
-{
-	FACE_A_X,
-	FACE_A_Y,
-	FACE_B_X,
-	FACE_B_Y
-};
-
 enum EdgeNumbers
 {
 	NO_EDGE = 0,
@@ -152,18 +152,83 @@ static void ComputeIncidentEdge(ClipVertex c[2], const Vec2& h, const Vec2& pos,
 	c[1].v = pos + Rot * c[1].v;
 }
 
-// The normal points from A to B
-int Collide(Contact* contacts, Body* bodyA, Body* bodyB)
+BoxTransform::BoxTransform(const Body* body)
 {
+	position = body->position;
+	rotation = Mat22(body->rot);
+	halfWidth = 0.5f * body->width;
+}
 
-	// Setup
-	Vec2 hA = 0.5f * bodyA->width;
-	Vec2 hB = 0.5f * bodyB->width;
+BoxTransform::BoxTransform(const BoxTransform& body, const BoxShape& box)
+{
+	position = body.position + body.rotation * box.position;
+	rotation = body.rotation * Mat22(box.rot);
+	halfWidth = 0.5f * box.width;
+}
 
-	Vec2 posA = bodyA->position;
-	Vec2 posB = bodyB->position;
+// Face separations of two boxes. C = RotA^T * RotB is a rotation by the
+// relative angle, so |C| only needs its cosine and sine. The batch kernel
+// below evaluates the same expressions lane by lane.
+static void ComputeFaceSeparations(Vec2& faceA, Vec2& faceB, const BoxTransform& A, const BoxTransform& B)
+{
+	float cA = A.rotation.col1.x, sA = A.rotation.col1.y;
+	float cB = B.rotation.col1.x, sB = B.rotation.col1.y;
+
+	float dpx = B.position.x - A.position.x;
+	float dpy = B.position.y - A.position.y;
+
+	float cc = fabsf(cA * cB + sA * sB);
+	float ss = fabsf(cA * sB - sA * cB);
 
-	Mat22 RotA(bodyA->rotation), RotB(bodyB->rotation);
+	float dAx = fabsf( cA * dpx + sA * dpy);
+	float dAy = fabsf(-sA * dpx + cA * dpy);
+	float dBx = fabsf( cB * dpx + sB * dpy);
+	float dBy = fabsf(-sB * dpx + cB * dpy);
+
+	faceA.x = dAx - A.halfWidth.x - (cc * B.halfWidth.x + ss * B.halfWidth.y);
+	faceA.y = dAy - A.halfWidth.y - (ss * B.halfWidth.x + cc * B.halfWidth.y);
+	faceB.x = dBx - (cc * A.halfWidth.x + ss * A.halfWidth.y) - B.halfWidth.x;
+	faceB.y = dBy - (ss * A.halfWidth.x + cc * A.halfWidth.y) - B.halfWidth.y;
+}
+
+// Returns true and fills separatingAxis if a face axis separates the boxes
+// by more than margin.
+static bool FindSeparatingAxis(SeparatingAxis* separatingAxis, const Vec2& faceA, const Vec2& faceB, float margin)
+{
+	SeparatingAxis sa;
+	if (faceA.x > margin || faceA.y > margin)
+	{
+		sa.axis = faceA.x > faceA.y ? FACE_A_X : FACE_A_Y;
+		sa.separation = Max(faceA.x, faceA.y);
+	}
+	else if (faceB.x > margin || faceB.y > margin)
+	{
+		sa.axis = faceB.x > faceB.y ? FACE_B_X : FACE_B_Y;
+		sa.separation = Max(faceB.x, faceB.y);
+	}
+	else
+	{
+		return false;
+	}
+
+	if (separatingAxis)
+		*separatingAxis = sa;
+
+	return true;
+}
+
+// Builds the manifold of two boxes that passed the face tests.
+static int ClipBoxes(Contact* contacts, const BoxTransform& A, const BoxTransform& B,
+					 const Vec2& faceA, const Vec2& faceB, float margin)
+{
+	Vec2 hA = A.halfWidth;
+	Vec2 hB = B.halfWidth;
+
+	Vec2 posA = A.position;
+	Vec2 posB = B.position;
+
+	Mat22 RotA = A.rotation;
+	Mat22 RotB = B.rotation;
 
 	Mat22 RotAT = RotA.Transpose();
 	Mat22 RotBT = RotB.Transpose();
@@ -172,20 +237,6 @@ int Collide(Contact* contacts, Body* bodyA, Body* bodyB)
 	Vec2 dA = RotAT * dp;
 	Vec2 dB = RotBT * dp;
 
-	Mat22 C = RotAT * RotB;
-	Mat22 absC = Abs(C);
-	Mat22 absCT = absC.Transpose();
-
-	// Box A faces
-	Vec2 faceA = Abs(dA) - hA - absC * hB;
-	if (faceA.x > 0.0f || faceA.y > 0.0f)
-		return 0;
-
-	// Box B faces
-	Vec2 faceB = Abs(dB) - absCT * hA - hB;
-	if (faceB.x > 0.0f || faceB.y > 0.0f)
-		return 0;
-
 	// Find best axis
 	Axis axis;
 	float separation;
@@ -313,19 +364,357 @@ int Collide(Contact* contacts, Body* bodyA, Body* bodyB)
 	{
 		float separation = Dot(frontNormal, clipPoints2[i].v) - front;
 
-		if (separation <= 0)
+		if (separation <= margin)
 		{
 			contacts[numContacts].separation = separation;
 			contacts[numContacts].normal = normal;
 			// slide contact point onto reference face (easy to cull)
 			contacts[numContacts].position = clipPoints2[i].v - separation * frontNormal;
 			contacts[numContacts].feature = clipPoints2[i].fp;
+
+			// Anchor the reference and incident points on their bodies so the
+			// separation can be recomputed after the bodies move.
+			Vec2 pointA = contacts[numContacts].position;
+			Vec2 pointB = clipPoints2[i].v;
 			if (axis == FACE_B_X || axis == FACE_B_Y)
+			{
 				Flip(contacts[numContacts].feature);
+				Swap(pointA, pointB);
+			}
+			contacts[numContacts].localAnchor1 = RotAT * (pointA - posA);
+			contacts[numContacts].localAnchor2 = RotBT * (pointB - posB);
 			++numContacts;
 		}
 	}
 
-	//printf("Debug - Collide - %d \n", numContacts);
 	return numContacts;
-}
\ No newline at end of file
+}
+
+// The normal points from A to B. Points separated by up to margin are kept
+// as speculative contacts. If a face axis separates the boxes by more than
+// margin it is written to separatingAxis.
+int CollideBoxes(Contact* contacts, const BoxTransform& A, const BoxTransform& B, float margin, SeparatingAxis* separatingAxis)
+{
+	Vec2 faceA, faceB;
+	ComputeFaceSeparations(faceA, faceB, A, B);
+
+	if (FindSeparatingAxis(separatingAxis, faceA, faceB, margin))
+		return 0;
+
+	return ClipBoxes(contacts, A, B, faceA, faceB, margin);
+}
+
+int Collide(Contact* contacts, Body* bodyA, Body* bodyB, float margin, SeparatingAxis* separatingAxis)
+{
+	return CollideBoxes(contacts, BoxTransform(bodyA), BoxTransform(bodyB), margin, separatingAxis);
+}
+
+void BoxPairBatch::Clear()
+{
+	pAx.clear(); pAy.clear(); cA.clear(); sA.clear(); hAx.clear(); hAy.clear();
+	pBx.clear(); pBy.clear(); cB.clear(); sB.clear(); hBx.clear(); hBy.clear();
+	margin.clear();
+}
+
+void BoxPairBatch::Add(const BoxTransform& A, const BoxTransform& B, float pairMargin)
+{
+	pAx.push_back(A.position.x); pAy.push_back(A.position.y);
+	cA.push_back(A.rotation.col1.x); sA.push_back(A.rotation.col1.y);
+	hAx.push_back(A.halfWidth.x); hAy.push_back(A.halfWidth.y);
+
+	pBx.push_back(B.position.x); pBy.push_back(B.position.y);
+	cB.push_back(B.rotation.col1.x); sB.push_back(B.rotation.col1.y);
+	hBx.push_back(B.halfWidth.x); hBy.push_back(B.halfWidth.y);
+
+	margin.push_back(pairMargin);
+}
+
+BoxTransform BoxPairBatch::TransformA(int i) const
+{
+	BoxTransform xf;
+	xf.position.Set(pAx[i], pAy[i]);
+	xf.rotation = Mat22(Vec2(cA[i], sA[i]), Vec2(-sA[i], cA[i]));
+	xf.halfWidth.Set(hAx[i], hAy[i]);
+	return xf;
+}
+
+BoxTransform BoxPairBatch::TransformB(int i) const
+{
+	BoxTransform xf;
+	xf.position.Set(pBx[i], pBy[i]);
+	xf.rotation = Mat22(Vec2(cB[i], sB[i]), Vec2(-sB[i], cB[i]));
+	xf.halfWidth.Set(hBx[i], hBy[i]);
+	return xf;
+}
+
+// Clips pair i if it passed the face tests, appending a manifold when it
+// produced contacts.
+static void FinishPair(std::vector<Manifold>& manifolds, SeparatingAxis* separatingAxes,
+					   const BoxPairBatch& batch, int i, const Vec2& faceA, const Vec2& faceB)
+{
+	separatingAxes[i].axis = FACE_A_X;
+	separatingAxes[i].separation = 0.0f;
+
+	if (FindSeparatingAxis(separatingAxes + i, faceA, faceB, batch.margin[i]))
+		return;
+
+	Manifold m;
+	m.pair = i;
+	m.numContacts = ClipBoxes(m.contacts, batch.TransformA(i), batch.TransformB(i), faceA, faceB, batch.margin[i]);
+	if (m.numContacts > 0)
+		manifolds.push_back(m);
+}
+
+// Face tests run four pairs at a time. Lanes where no axis separates the
+// boxes are clipped one at a time.
+int CollideBatch(std::vector<Manifold>& manifolds, SeparatingAxis* separatingAxes, const BoxPairBatch& batch)
+{
+	manifolds.clear();
+
+	int count = batch.Size();
+	int i = 0;
+
+#if BOX2D_SIMD_SSE
+	const __m128 signMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 cA = _mm_loadu_ps(&batch.cA[i]), sA = _mm_loadu_ps(&batch.sA[i]);
+		__m128 cB = _mm_loadu_ps(&batch.cB[i]), sB = _mm_loadu_ps(&batch.sB[i]);
+		__m128 hAx = _mm_loadu_ps(&batch.hAx[i]), hAy = _mm_loadu_ps(&batch.hAy[i]);
+		__m128 hBx = _mm_loadu_ps(&batch.hBx[i]), hBy = _mm_loadu_ps(&batch.hBy[i]);
+
+		__m128 dpx = _mm_sub_ps(_mm_loadu_ps(&batch.pBx[i]), _mm_loadu_ps(&batch.pAx[i]));
+		__m128 dpy = _mm_sub_ps(_mm_loadu_ps(&batch.pBy[i]), _mm_loadu_ps(&batch.pAy[i]));
+
+		__m128 cc = _mm_and_ps(signMask, _mm_add_ps(_mm_mul_ps(cA, cB), _mm_mul_ps(sA, sB)));
+		__m128 ss = _mm_and_ps(signMask, _mm_sub_ps(_mm_mul_ps(cA, sB), _mm_mul_ps(sA, cB)));
+
+		__m128 dAx = _mm_and_ps(signMask, _mm_add_ps(_mm_mul_ps(cA, dpx), _mm_mul_ps(sA, dpy)));
+		__m128 dAy = _mm_and_ps(signMask, _mm_sub_ps(_mm_mul_ps(cA, dpy), _mm_mul_ps(sA, dpx)));
+		__m128 dBx = _mm_and_ps(signMask, _mm_add_ps(_mm_mul_ps(cB, dpx), _mm_mul_ps(sB, dpy)));
+		__m128 dBy = _mm_and_ps(signMask, _mm_sub_ps(_mm_mul_ps(cB, dpy), _mm_mul_ps(sB, dpx)));
+
+		__m128 faceAx = _mm_sub_ps(_mm_sub_ps(dAx, hAx), _mm_add_ps(_mm_mul_ps(cc, hBx), _mm_mul_ps(ss, hBy)));
+		__m128 faceAy = _mm_sub_ps(_mm_sub_ps(dAy, hAy), _mm_add_ps(_mm_mul_ps(ss, hBx), _mm_mul_ps(cc, hBy)));
+		__m128 faceBx = _mm_sub_ps(_mm_sub_ps(dBx, _mm_add_ps(_mm_mul_ps(cc, hAx), _mm_mul_ps(ss, hAy))), hBx);
+		__m128 faceBy = _mm_sub_ps(_mm_sub_ps(dBy, _mm_add_ps(_mm_mul_ps(ss, hAx), _mm_mul_ps(cc, hAy))), hBy);
+
+		__m128 margin = _mm_loadu_ps(&batch.margin[i]);
+		__m128 apart = _mm_or_ps(_mm_or_ps(_mm_cmpgt_ps(faceAx, margin), _mm_cmpgt_ps(faceAy, margin)),
+								 _mm_or_ps(_mm_cmpgt_ps(faceBx, margin), _mm_cmpgt_ps(faceBy, margin)));
+
+		float fAx[4], fAy[4], fBx[4], fBy[4];
+		_mm_storeu_ps(fAx, faceAx);
+		_mm_storeu_ps(fAy, faceAy);
+		_mm_storeu_ps(fBx, faceBx);
+		_mm_storeu_ps(fBy, faceBy);
+
+		int apartMask = _mm_movemask_ps(apart);
+		for (int lane = 0; lane < 4; ++lane)
+		{
+			int k = i + lane;
+			if (apartMask & (1 << lane))
+			{
+				// Same axis choice as FindSeparatingAxis, without clipping.
+				SeparatingAxis& sa = separatingAxes[k];
+				float m = batch.margin[k];
+				if (fAx[lane] > m || fAy[lane] > m)
+				{
+					sa.axis = fAx[lane] > fAy[lane] ? FACE_A_X : FACE_A_Y;
+					sa.separation = Max(fAx[lane], fAy[lane]);
+				}
+				else
+				{
+					sa.axis = fBx[lane] > fBy[lane] ? FACE_B_X : FACE_B_Y;
+					sa.separation = Max(fBx[lane], fBy[lane]);
+				}
+				continue;
+			}
+
+			FinishPair(manifolds, separatingAxes, batch, k, Vec2(fAx[lane], fAy[lane]), Vec2(fBx[lane], fBy[lane]));
+		}
+	}
+#endif
+
+	// Remaining pairs, or all of them without SSE
+	for (; i < count; ++i)
+	{
+		Vec2 faceA, faceB;
+		ComputeFaceSeparations(faceA, faceB, batch.TransformA(i), batch.TransformB(i));
+		FinishPair(manifolds, separatingAxes, batch, i, faceA, faceB);
+	}
+
+	return (int)manifolds.size();
+}
+
+// Separation of the boxes along a single face axis. This is the cheap test
+// used to confirm that a cached separating axis still separates the pair.
+float SeparationOnAxis(Body* bodyA, Body* bodyB, Axis axis)
+{
+	Vec2 hA = 0.5f * bodyA->width;
+	Vec2 hB = 0.5f * bodyB->width;
+
+	Mat22 RotA(bodyA->rot), RotB(bodyB->rot);
+	Mat22 RotAT = RotA.Transpose();
+	Mat22 RotBT = RotB.Transpose();
+
+	Vec2 dp = bodyB->position - bodyA->position;
+	Mat22 absC = Abs(RotAT * RotB);
+
+	switch (axis)
+	{
+	case FACE_A_X:
+	case FACE_A_Y:
+		{
+			Vec2 faceA = Abs(RotAT * dp) - hA - absC * hB;
+			return axis == FACE_A_X ? faceA.x : faceA.y;
+		}
+
+	default:
+		{
+			Vec2 faceB = Abs(RotBT * dp) - absC.Transpose() * hA - hB;
+			return axis == FACE_B_X ? faceB.x : faceB.y;
+		}
+	}
+}
+
+// Slab test in the box frame.
+bool RayCastBox(float* fraction, Vec2* normal, const BoxTransform& box, const Vec2& p1, const Vec2& p2, float maxFraction)
+{
+	Mat22 RotT = box.rotation.Transpose();
+	Vec2 p = RotT * (p1 - box.position);
+	Vec2 d = RotT * (p2 - p1);
+
+	float pi[2] = { p.x, p.y };
+	float di[2] = { d.x, d.y };
+	float hi[2] = { box.halfWidth.x, box.halfWidth.y };
+
+	float tmin = -FLT_MAX;
+	float tmax = FLT_MAX;
+	Vec2 localNormal(0.0f, 0.0f);
+
+	for (int i = 0; i < 2; ++i)
+	{
+		if (Abs(di[i]) < FLT_EPSILON)
+		{
+			// Parallel to this slab
+			if (pi[i] < -hi[i] || hi[i] < pi[i])
+				return false;
+		}
+		else
+		{
+			float inv_d = 1.0f / di[i];
+			float t1 = (-hi[i] - pi[i]) * inv_d;
+			float t2 = (hi[i] - pi[i]) * inv_d;
+
+			// Sign of the face the ray enters through
+			float s = -1.0f;
+			if (t1 > t2)
+			{
+				Swap(t1, t2);
+				s = 1.0f;
+			}
+
+			if (t1 > tmin)
+			{
+				tmin = t1;
+				localNormal = i == 0 ? Vec2(s, 0.0f) : Vec2(0.0f, s);
+			}
+
+			tmax = Min(tmax, t2);
+			if (tmin > tmax)
+				return false;
+		}
+	}
+
+	if (tmin < 0.0f || maxFraction < tmin)
+		return false;
+
+	*fraction = tmin;
+	*normal = box.rotation * localNormal;
+	return true;
+}
+
+bool TestOverlapBoxes(const BoxTransform& A, const BoxTransform& B)
+{
+	Vec2 faceA, faceB;
+	ComputeFaceSeparations(faceA, faceB, A, B);
+	return faceA.x <= 0.0f && faceA.y <= 0.0f && faceB.x <= 0.0f && faceB.y <= 0.0f;
+}
+
+// The face normals of the two boxes are the only separating axes, so the
+// boxes overlap exactly when their projections overlap on all four. Along
+// each axis that is a slab in t, and the time of impact is the latest entry
+// of the four slabs.
+bool BoxCastBox(float* fraction, Vec2* normal, const BoxTransform& A, const Vec2& translation, const BoxTransform& B, float maxFraction)
+{
+	Vec2 axes[4] = { A.rotation.col1, A.rotation.col2, B.rotation.col1, B.rotation.col2 };
+	Vec2 dp = A.position - B.position;
+
+	float tmin = -FLT_MAX;
+	float tmax = FLT_MAX;
+	Vec2 n(0.0f, 0.0f);
+
+	// Axis of least penetration, for boxes that start out overlapping
+	float minDepth = FLT_MAX;
+	Vec2 pushOut(0.0f, 1.0f);
+
+	for (int i = 0; i < 4; ++i)
+	{
+		const Vec2& axis = axes[i];
+
+		// Projected radius of both boxes on this axis
+		float r = Abs(Dot(axis, A.rotation.col1)) * A.halfWidth.x + Abs(Dot(axis, A.rotation.col2)) * A.halfWidth.y
+				+ Abs(Dot(axis, B.rotation.col1)) * B.halfWidth.x + Abs(Dot(axis, B.rotation.col2)) * B.halfWidth.y;
+
+		float p = Dot(axis, dp);
+		float v = Dot(axis, translation);
+
+		if (r - Abs(p) < minDepth)
+		{
+			minDepth = r - Abs(p);
+			pushOut = (p < 0.0f ? -1.0f : 1.0f) * axis;
+		}
+
+		if (Abs(v) < FLT_EPSILON)
+		{
+			if (Abs(p) > r)
+				return false;
+			continue;
+		}
+
+		float inv_v = 1.0f / v;
+		float t1 = (-r - p) * inv_v;
+		float t2 = (r - p) * inv_v;
+
+		// A enters the slab on the side it is coming from.
+		float s = v > 0.0f ? -1.0f : 1.0f;
+		if (t1 > t2)
+			Swap(t1, t2);
+
+		if (t1 > tmin)
+		{
+			tmin = t1;
+			n = s * axis;
+		}
+
+		tmax = Min(tmax, t2);
+		if (tmin > tmax)
+			return false;
+	}
+
+	if (tmax < 0.0f || maxFraction < tmin)
+		return false;
+
+	if (tmin <= 0.0f)
+	{
+		*fraction = 0.0f;
+		*normal = pushOut;
+		return true;
+	}
+
+	*fraction = tmin;
+	*normal = n;
+	return true;
+}
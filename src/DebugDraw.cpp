@@ -0,0 +1,108 @@
+/*
+* Copyright (c) 2006-2009 Erin Catto http://www.gphysics.com
+*
+* Permission to use, copy, modify, distribute and sell this software
+* and its documentation for any purpose is hereby granted without fee,
+* provided that the above copyright notice appear in all copies.
+* Erin Catto makes no representations about the suitability
+* of this software for any purpose.
+* It is provided "as is" without express or implied warranty.
+*/
+
+#include "box2d-lite/DebugDraw.h"
+#include "box2d-lite/World.h"
+
+DebugDraw::DebugDraw() :
+	bodyColor(0.8f, 0.8f, 0.9f),
+	brokenBodyColor(1.0f, 0.7f, 0.3f),
+	highlightColor(0.4f, 0.9f, 0.4f),
+	jointColor(0.5f, 0.5f, 0.8f),
+	contactColor(1.0f, 0.0f, 0.0f),
+	highlight(NULL)
+{
+}
+
+void DebugDraw::Clear()
+{
+	lines.clear();
+	points.clear();
+}
+
+void DebugDraw::AddLine(const Vec2& p1, const Vec2& p2, const Color& color)
+{
+	DebugVertex v;
+	v.color = color;
+	v.position = p1;
+	lines.push_back(v);
+	v.position = p2;
+	lines.push_back(v);
+}
+
+void DebugDraw::AddPoint(const Vec2& p, const Color& color)
+{
+	DebugVertex v;
+	v.position = p;
+	v.color = color;
+	points.push_back(v);
+}
+
+void DebugDraw::AddBox(const Vec2& position, float rotation, const Vec2& width, const Color& color)
+{
+	Mat22 R(rotation);
+	Vec2 h = 0.5f * width;
+
+	Vec2 v1 = position + R * Vec2(-h.x, -h.y);
+	Vec2 v2 = position + R * Vec2( h.x, -h.y);
+	Vec2 v3 = position + R * Vec2( h.x,  h.y);
+	Vec2 v4 = position + R * Vec2(-h.x,  h.y);
+
+	AddLine(v1, v2, color);
+	AddLine(v2, v3, color);
+	AddLine(v3, v4, color);
+	AddLine(v4, v1, color);
+}
+
+void DebugDraw::AddSnapshot(const WorldSnapshot& snapshot)
+{
+	for (int i = 0; i < (int)snapshot.bodies.size(); ++i)
+	{
+		const BodySnapshot& b = snapshot.bodies[i];
+
+		Color color = bodyColor;
+		if (b.exists == false)
+			color = brokenBodyColor;
+		else if (b.body == highlight)
+			color = highlightColor;
+
+		if (b.boxes.empty())
+		{
+			AddBox(b.position, b.rotation, b.width, color);
+			continue;
+		}
+
+		Mat22 R(b.rotation);
+		for (int k = 0; k < (int)b.boxes.size(); ++k)
+		{
+			const BoxShape& box = b.boxes[k];
+			AddBox(b.position + R * box.position, b.rotation + box.rotation, box.width, color);
+		}
+	}
+
+	for (int i = 0; i < (int)snapshot.tiles.size(); ++i)
+	{
+		const AABB& tile = snapshot.tiles[i];
+		AddBox(tile.GetCenter(), 0.0f, tile.upperBound - tile.lowerBound, bodyColor);
+	}
+
+	for (int i = 0; i < (int)snapshot.joints.size(); ++i)
+	{
+		const JointSnapshot& j = snapshot.joints[i];
+		AddLine(j.position1, j.anchor1, jointColor);
+		AddLine(j.position2, j.anchor2, jointColor);
+	}
+
+	for (int i = 0; i < (int)snapshot.contacts.size(); ++i)
+	{
+		AddPoint(snapshot.contacts[i].position, contactColor);
+	}
+}
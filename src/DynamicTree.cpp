@@ -0,0 +1,331 @@
+/*
+* Copyright (c) 2009 Erin Catto http://www.gphysics.com
+*
+* Permission to use, copy, modify, distribute and sell this software
+* and its documentation for any purpose is hereby granted without fee,
+* provided that the above copyright notice appear in all copies.
+* Erin Catto makes no representations about the suitability
+* of this software for any purpose.
+* It is provided "as is" without express or implied warranty.
+*/
+
+#include "box2d-lite/DynamicTree.h"
+
+DynamicTree::DynamicTree()
+{
+	root = NULL_NODE;
+	freeList = NULL_NODE;
+}
+
+void DynamicTree::Clear()
+{
+	root = NULL_NODE;
+	freeList = NULL_NODE;
+	nodes.clear();
+}
+
+int DynamicTree::AllocateNode()
+{
+	int nodeId;
+	if (freeList != NULL_NODE)
+	{
+		nodeId = freeList;
+		freeList = nodes[nodeId].parent;
+	}
+	else
+	{
+		nodeId = (int)nodes.size();
+		nodes.push_back(TreeNode());
+	}
+
+	TreeNode& node = nodes[nodeId];
+	node.userData = -1;
+	node.parent = NULL_NODE;
+	node.child1 = NULL_NODE;
+	node.child2 = NULL_NODE;
+	node.height = 0;
+	return nodeId;
+}
+
+void DynamicTree::FreeNode(int nodeId)
+{
+	nodes[nodeId].parent = freeList;
+	nodes[nodeId].height = -1;
+	freeList = nodeId;
+}
+
+int DynamicTree::CreateProxy(const AABB& aabb, int userData)
+{
+	int proxyId = AllocateNode();
+	nodes[proxyId].aabb = aabb;
+	nodes[proxyId].userData = userData;
+
+	InsertLeaf(proxyId);
+	return proxyId;
+}
+
+void DynamicTree::DestroyProxy(int proxyId)
+{
+	assert(nodes[proxyId].IsLeaf());
+
+	RemoveLeaf(proxyId);
+	FreeNode(proxyId);
+}
+
+void DynamicTree::MoveProxy(int proxyId, const AABB& aabb)
+{
+	assert(nodes[proxyId].IsLeaf());
+
+	RemoveLeaf(proxyId);
+	nodes[proxyId].aabb = aabb;
+	InsertLeaf(proxyId);
+}
+
+// Walks down to the sibling that grows the total perimeter the least, then
+// refits and rebalances on the way back up.
+void DynamicTree::InsertLeaf(int leaf)
+{
+	if (root == NULL_NODE)
+	{
+		root = leaf;
+		nodes[root].parent = NULL_NODE;
+		return;
+	}
+
+	AABB leafAABB = nodes[leaf].aabb;
+	int index = root;
+	while (!nodes[index].IsLeaf())
+	{
+		int child1 = nodes[index].child1;
+		int child2 = nodes[index].child2;
+
+		float area = nodes[index].aabb.GetPerimeter();
+		float combinedArea = Combine(nodes[index].aabb, leafAABB).GetPerimeter();
+
+		// Cost of creating a new parent for this node and the new leaf
+		float cost = 2.0f * combinedArea;
+
+		// Minimum cost of pushing the leaf further down the tree
+		float inheritanceCost = 2.0f * (combinedArea - area);
+
+		float cost1 = Combine(leafAABB, nodes[child1].aabb).GetPerimeter() + inheritanceCost;
+		if (!nodes[child1].IsLeaf())
+			cost1 -= nodes[child1].aabb.GetPerimeter();
+
+		float cost2 = Combine(leafAABB, nodes[child2].aabb).GetPerimeter() + inheritanceCost;
+		if (!nodes[child2].IsLeaf())
+			cost2 -= nodes[child2].aabb.GetPerimeter();
+
+		if (cost < cost1 && cost < cost2)
+			break;
+
+		index = cost1 < cost2 ? child1 : child2;
+	}
+
+	int sibling = index;
+
+	// AllocateNode may grow the node array, so only indices are kept.
+	int oldParent = nodes[sibling].parent;
+	int newParent = AllocateNode();
+	nodes[newParent].parent = oldParent;
+	nodes[newParent].aabb = Combine(leafAABB, nodes[sibling].aabb);
+	nodes[newParent].height = nodes[sibling].height + 1;
+	nodes[newParent].child1 = sibling;
+	nodes[newParent].child2 = leaf;
+	nodes[sibling].parent = newParent;
+	nodes[leaf].parent = newParent;
+
+	if (oldParent != NULL_NODE)
+	{
+		if (nodes[oldParent].child1 == sibling)
+			nodes[oldParent].child1 = newParent;
+		else
+			nodes[oldParent].child2 = newParent;
+	}
+	else
+	{
+		root = newParent;
+	}
+
+	index = nodes[leaf].parent;
+	while (index != NULL_NODE)
+	{
+		index = Balance(index);
+
+		int child1 = nodes[index].child1;
+		int child2 = nodes[index].child2;
+
+		nodes[index].height = 1 + (nodes[child1].height > nodes[child2].height ? nodes[child1].height : nodes[child2].height);
+		nodes[index].aabb = Combine(nodes[child1].aabb, nodes[child2].aabb);
+
+		index = nodes[index].parent;
+	}
+}
+
+void DynamicTree::RemoveLeaf(int leaf)
+{
+	if (leaf == root)
+	{
+		root = NULL_NODE;
+		return;
+	}
+
+	int parent = nodes[leaf].parent;
+	int grandParent = nodes[parent].parent;
+	int sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+
+	if (grandParent != NULL_NODE)
+	{
+		// Replace the parent with the sibling and refit the ancestors.
+		if (nodes[grandParent].child1 == parent)
+			nodes[grandParent].child1 = sibling;
+		else
+			nodes[grandParent].child2 = sibling;
+		nodes[sibling].parent = grandParent;
+		FreeNode(parent);
+
+		int index = grandParent;
+		while (index != NULL_NODE)
+		{
+			index = Balance(index);
+
+			int child1 = nodes[index].child1;
+			int child2 = nodes[index].child2;
+
+			nodes[index].aabb = Combine(nodes[child1].aabb, nodes[child2].aabb);
+			nodes[index].height = 1 + (nodes[child1].height > nodes[child2].height ? nodes[child1].height : nodes[child2].height);
+
+			index = nodes[index].parent;
+		}
+	}
+	else
+	{
+		root = sibling;
+		nodes[sibling].parent = NULL_NODE;
+		FreeNode(parent);
+	}
+}
+
+// Performs a left or right rotation if node A is imbalanced.
+// Returns the new root index.
+int DynamicTree::Balance(int iA)
+{
+	TreeNode* A = &nodes[iA];
+	if (A->IsLeaf() || A->height < 2)
+		return iA;
+
+	int iB = A->child1;
+	int iC = A->child2;
+	TreeNode* B = &nodes[iB];
+	TreeNode* C = &nodes[iC];
+
+	int balance = C->height - B->height;
+
+	// Rotate C up
+	if (balance > 1)
+	{
+		int iF = C->child1;
+		int iG = C->child2;
+		TreeNode* F = &nodes[iF];
+		TreeNode* G = &nodes[iG];
+
+		// Swap A and C
+		C->child1 = iA;
+		C->parent = A->parent;
+		A->parent = iC;
+
+		// A's old parent should point to C
+		if (C->parent != NULL_NODE)
+		{
+			if (nodes[C->parent].child1 == iA)
+				nodes[C->parent].child1 = iC;
+			else
+				nodes[C->parent].child2 = iC;
+		}
+		else
+		{
+			root = iC;
+		}
+
+		// Rotate
+		if (F->height > G->height)
+		{
+			C->child2 = iF;
+			A->child2 = iG;
+			G->parent = iA;
+			A->aabb = Combine(B->aabb, G->aabb);
+			C->aabb = Combine(A->aabb, F->aabb);
+
+			A->height = 1 + (B->height > G->height ? B->height : G->height);
+			C->height = 1 + (A->height > F->height ? A->height : F->height);
+		}
+		else
+		{
+			C->child2 = iG;
+			A->child2 = iF;
+			F->parent = iA;
+			A->aabb = Combine(B->aabb, F->aabb);
+			C->aabb = Combine(A->aabb, G->aabb);
+
+			A->height = 1 + (B->height > F->height ? B->height : F->height);
+			C->height = 1 + (A->height > G->height ? A->height : G->height);
+		}
+
+		return iC;
+	}
+
+	// Rotate B up
+	if (balance < -1)
+	{
+		int iD = B->child1;
+		int iE = B->child2;
+		TreeNode* D = &nodes[iD];
+		TreeNode* E = &nodes[iE];
+
+		// Swap A and B
+		B->child1 = iA;
+		B->parent = A->parent;
+		A->parent = iB;
+
+		// A's old parent should point to B
+		if (B->parent != NULL_NODE)
+		{
+			if (nodes[B->parent].child1 == iA)
+				nodes[B->parent].child1 = iB;
+			else
+				nodes[B->parent].child2 = iB;
+		}
+		else
+		{
+			root = iB;
+		}
+
+		// Rotate
+		if (D->height > E->height)
+		{
+			B->child2 = iD;
+			A->child1 = iE;
+			E->parent = iA;
+			A->aabb = Combine(C->aabb, E->aabb);
+			B->aabb = Combine(A->aabb, D->aabb);
+
+			A->height = 1 + (C->height > E->height ? C->height : E->height);
+			B->height = 1 + (A->height > D->height ? A->height : D->height);
+		}
+		else
+		{
+			B->child2 = iE;
+			A->child1 = iD;
+			D->parent = iA;
+			A->aabb = Combine(C->aabb, D->aabb);
+			B->aabb = Combine(A->aabb, E->aabb);
+
+			A->height = 1 + (C->height > D->height ? C->height : D->height);
+			B->height = 1 + (A->height > E->height ? A->height : E->height);
+		}
+
+		return iB;
+	}
+
+	return iA;
+}
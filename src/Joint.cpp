@@ -35,8 +35,8 @@ void Joint::Set(Body* b1, Body* b2, const Vec2& anchor)
 void Joint::PreStep(float inv_dt)
 {
 	// Pre-compute anchors, mass matrix, and bias.
-	Mat22 Rot1(body1->rotation);
-	Mat22 Rot2(body2->rotation);
+	Mat22 Rot1(body1->rot);
+	Mat22 Rot2(body2->rot);
 
 	r1 = Rot1 * localAnchor1;
 	r2 = Rot2 * localAnchor2;
@@ -91,7 +91,9 @@ void Joint::PreStep(float inv_dt)
 	}
 }
 
-void Joint::ApplyImpulse()
+// Returns how much the impulse changed the relative velocity of the
+// anchors, |K * impulse|, angular terms included.
+float Joint::ApplyImpulse()
 {
     Vec2 dv = body2->velocity + Cross(body2->angularVelocity, r2) - body1->velocity - Cross(body1->angularVelocity, r1);
 
@@ -106,4 +108,7 @@ void Joint::ApplyImpulse()
 	body2->angularVelocity += body2->invI * Cross(r2, impulse);
 
 	P += impulse;
+
+	Vec2 dv2 = body2->velocity + Cross(body2->angularVelocity, r2) - body1->velocity - Cross(body1->angularVelocity, r1);
+	return (dv2 - dv).Length();
 }
@@ -0,0 +1,257 @@
+/*
+* Copyright (c) 2006-2009 Erin Catto http://www.gphysics.com
+*
+* Permission to use, copy, modify, distribute and sell this software
+* and its documentation for any purpose is hereby granted without fee,
+* provided that the above copyright notice appear in all copies.
+* Erin Catto makes no representations about the suitability
+* of this software for any purpose.
+* It is provided "as is" without express or implied warranty.
+*/
+
+#include "box2d-lite/SceneBuilder.h"
+#include "box2d-lite/World.h"
+
+SceneBuilder::SceneBuilder(World* world, unsigned int seed) : world(world), random(seed)
+{
+}
+
+void SceneBuilder::Clear(unsigned int seed)
+{
+	// The world resets the bodies' proxies, so clear it while they exist.
+	world->Clear();
+	bodies.clear();
+	joints.clear();
+	random.Seed(seed);
+}
+
+Body* SceneBuilder::AddBox(const Vec2& position, const Vec2& width, float mass, float rotation)
+{
+	bodies.push_back(Body());
+	Body* b = &bodies.back();
+	b->Set(width, mass);
+	b->position = position;
+	b->rotation = rotation;
+	world->Add(b);
+	return b;
+}
+
+Body* SceneBuilder::AddCompound(const Vec2& position, const BoxShape* boxes, int count, float mass, float rotation)
+{
+	bodies.push_back(Body());
+	Body* b = &bodies.back();
+	Vec2 centroid = b->SetCompound(boxes, count, mass);
+	b->position = position + Mat22(rotation) * centroid;
+	b->rotation = rotation;
+	world->Add(b);
+	return b;
+}
+
+Body* SceneBuilder::AddGround(float width)
+{
+	return AddBox(Vec2(0.0f, -10.0f), Vec2(width, 20.0f), FLT_MAX);
+}
+
+Joint* SceneBuilder::AddJoint(Body* body1, Body* body2, const Vec2& anchor)
+{
+	joints.push_back(Joint());
+	Joint* j = &joints.back();
+	j->Set(body1, body2, anchor);
+	world->Add(j);
+	return j;
+}
+
+Joint* SceneBuilder::AddSpringJoint(Body* body1, Body* body2, const Vec2& anchor, float hertz, float dampingRatio, float timeStep)
+{
+	Joint* j = AddJoint(body1, body2, anchor);
+
+	// Spring-damper on the lighter body, as in the bridge demo
+	float mass = Min(body1->mass, body2->mass);
+	float omega = 2.0f * k_pi * hertz;
+	float d = 2.0f * mass * dampingRatio * omega;
+	float k = mass * omega * omega;
+
+	j->softness = 1.0f / (d + timeStep * k);
+	j->biasFactor = timeStep * k / (d + timeStep * k);
+	return j;
+}
+
+void SceneBuilder::Pyramid(int rows, const Vec2& base, const Vec2& boxWidth, float mass, const Vec2& spacing)
+{
+	float dx = boxWidth.x + spacing.x;
+	float dy = boxWidth.y + spacing.y;
+	Vec2 x(base.x - 0.5f * dx * (rows - 1), base.y + 0.5f * boxWidth.y);
+
+	for (int i = 0; i < rows; ++i)
+	{
+		Vec2 y = x;
+
+		for (int j = i; j < rows; ++j)
+		{
+			AddBox(y, boxWidth, mass);
+			y += Vec2(dx, 0.0f);
+		}
+
+		x += Vec2(0.5f * dx, dy);
+	}
+}
+
+void SceneBuilder::Wall(int columns, int rows, const Vec2& base, const Vec2& brickWidth, float mass)
+{
+	float left = base.x - 0.5f * columns * brickWidth.x;
+
+	for (int i = 0; i < rows; ++i)
+	{
+		float y = base.y + (i + 0.5f) * brickWidth.y;
+
+		// Odd rows are shifted by half a brick and closed by half bricks, so
+		// no brick overhangs the one below.
+		float shift = (i & 1) ? 0.5f * brickWidth.x : 0.0f;
+		int count = (i & 1) ? columns - 1 : columns;
+
+		for (int j = 0; j < count; ++j)
+		{
+			AddBox(Vec2(left + shift + (j + 0.5f) * brickWidth.x, y), brickWidth, mass);
+		}
+
+		if (i & 1)
+		{
+			Vec2 half(0.5f * brickWidth.x, brickWidth.y);
+			AddBox(Vec2(left + 0.25f * brickWidth.x, y), half, 0.5f * mass);
+			AddBox(Vec2(left + (columns - 0.25f) * brickWidth.x, y), half, 0.5f * mass);
+		}
+	}
+}
+
+void SceneBuilder::Dominoes(int count, const Vec2& base, float spacing, const Vec2& width, float mass)
+{
+	for (int i = 0; i < count; ++i)
+	{
+		Body* b = AddBox(Vec2(base.x + spacing * i, base.y + 0.5f * width.y), width, mass);
+		b->friction = 0.1f;
+
+		if (i == 0)
+			b->angularVelocity = -1.0f;
+	}
+}
+
+void SceneBuilder::Chain(Body* anchorBody, const Vec2& anchor, int links, const Vec2& linkWidth, float mass)
+{
+	Body* previous = anchorBody;
+	Vec2 p = anchor;
+
+	for (int i = 0; i < links; ++i)
+	{
+		Body* b = AddBox(p + Vec2(0.5f * linkWidth.x, 0.0f), linkWidth, mass);
+		AddJoint(previous, b, p);
+
+		previous = b;
+		p += Vec2(linkWidth.x, 0.0f);
+	}
+}
+
+void SceneBuilder::Ragdoll(const Vec2& position, float scale, float mass)
+{
+	float s = scale;
+
+	Body* torso = AddBox(position, s * Vec2(0.5f, 1.0f), 0.4f * mass);
+	Body* head = AddBox(position + s * Vec2(0.0f, 0.8f), s * Vec2(0.4f, 0.4f), 0.1f * mass);
+	AddJoint(torso, head, position + s * Vec2(0.0f, 0.55f));
+
+	for (int side = -1; side <= 1; side += 2)
+	{
+		Body* arm = AddBox(position + s * Vec2(0.5f * side, 0.35f), s * Vec2(0.5f, 0.18f), 0.1f * mass);
+		AddJoint(torso, arm, position + s * Vec2(0.25f * side, 0.35f));
+
+		Body* leg = AddBox(position + s * Vec2(0.15f * side, -0.85f), s * Vec2(0.2f, 0.7f), 0.15f * mass);
+		AddJoint(torso, leg, position + s * Vec2(0.15f * side, -0.5f));
+	}
+}
+
+void SceneBuilder::Ragdolls(int count, const Vec2& origin, float spacing, float scale, float mass)
+{
+	// Lay them out on a square-ish grid going up from origin.
+	int perRow = 1;
+	while (perRow * perRow < count)
+		++perRow;
+
+	for (int i = 0; i < count; ++i)
+	{
+		int column = i % perRow;
+		int row = i / perRow;
+		Vec2 p = origin + Vec2(spacing * (column - 0.5f * (perRow - 1)), 2.0f * scale + spacing * row);
+		Ragdoll(p, scale, mass);
+	}
+}
+
+void SceneBuilder::RandomPile(int count, const Vec2& base, float width, float minSize, float maxSize, float mass)
+{
+	if (count <= 0)
+		return;
+
+	// Cells large enough for any box at any rotation
+	float cell = 1.42f * maxSize;
+	int columns = (int)(width / cell);
+	if (columns < 1)
+		columns = 1;
+
+	Vec2 lower(base.x - 0.5f * columns * cell, base.y);
+
+	for (int i = 0; i < count; ++i)
+	{
+		int column = i % columns;
+		int row = i / columns;
+		Vec2 center(lower.x + (column + 0.5f) * cell, lower.y + (row + 0.5f) * cell);
+
+		Vec2 size(random.Next(minSize, maxSize), random.Next(minSize, maxSize));
+		float slack = 0.5f * (cell - 1.42f * Max(size.x, size.y));
+		Vec2 jitter(random.Next(-slack, slack), random.Next(-slack, slack));
+
+		AddBox(center + jitter, size, mass * size.x * size.y, random.Next(-k_pi, k_pi));
+	}
+}
+
+int SceneBuilder::Rain(int count, float xMin, float xMax, float y, float minSize, float maxSize, float mass)
+{
+	// One slot per body across the range, so a burst does not overlap. A
+	// rotated box needs its diagonal, 1.42 times its size, to fit the slot.
+	float slot = count > 0 ? (xMax - xMin) / count : 0.0f;
+	float largest = slot / 1.42f;
+
+	int added = 0;
+	for (int i = 0; i < count; ++i)
+	{
+		float size = Min(random.Next(minSize, Min(maxSize, largest)), largest);
+		float slack = Max(slot - 1.42f * size, 0.0f);
+		float x = xMin + (i + 0.5f) * slot + random.Next(-0.5f, 0.5f) * slack;
+		float rotation = random.Next(-k_pi, k_pi);
+
+		// Boxes from the last bursts may not have fallen clear yet.
+		Body* occupant;
+		float extent = 1.42f * size;
+		if (world->OverlapBox(&occupant, 1, Vec2(extent, extent), 0.0f, Vec2(x, y)) > 0)
+			continue;
+
+		Body* b = AddBox(Vec2(x, y), Vec2(size, size), mass, rotation);
+		b->velocity.Set(0.0f, -5.0f);
+		++added;
+	}
+
+	return added;
+}
+
+int RainEmitter::Update(SceneBuilder& scene, float dt)
+{
+	accumulator += rate * dt;
+	int count = (int)accumulator;
+	accumulator -= count;
+
+	int room = maxBodies - (int)scene.bodies.size();
+	if (count > room)
+		count = room > 0 ? room : 0;
+
+	if (count > 0)
+		count = scene.Rain(count, xMin, xMax, y, minSize, maxSize, mass);
+
+	return count;
+}
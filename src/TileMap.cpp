@@ -0,0 +1,210 @@
+/*
+* Copyright (c) 2006-2009 Erin Catto http://www.gphysics.com
+*
+* Permission to use, copy, modify, distribute and sell this software
+* and its documentation for any purpose is hereby granted without fee,
+* provided that the above copyright notice appear in all copies.
+* Erin Catto makes no representations about the suitability
+* of this software for any purpose.
+* It is provided "as is" without express or implied warranty.
+*/
+
+#include <math.h>
+
+#include "box2d-lite/TileMap.h"
+
+TileMap::TileMap()
+{
+	width = 0;
+	height = 0;
+	cellSize.Set(1.0f, 1.0f);
+	origin.Set(0.0f, 0.0f);
+	dirty = false;
+	queryStamp = 0;
+	body.proxyId = TILE_PROXY;
+}
+
+void TileMap::Set(int w, int h, const Vec2& size, const Vec2& o)
+{
+	width = w;
+	height = h;
+	cellSize = size;
+	origin = o;
+	cells.assign(width * height, 0);
+	cellRects.assign(width * height, -1);
+	rects.clear();
+	dirty = false;
+}
+
+void TileMap::Clear()
+{
+	Set(0, 0, cellSize, origin);
+}
+
+void TileMap::SetSolid(int x, int y, bool solid)
+{
+	assert(0 <= x && x < width && 0 <= y && y < height);
+	unsigned char value = solid ? 1 : 0;
+	if (cells[y * width + x] != value)
+	{
+		cells[y * width + x] = value;
+		dirty = true;
+	}
+}
+
+// Cells outside the grid are empty.
+bool TileMap::IsSolid(int x, int y) const
+{
+	if (x < 0 || x >= width || y < 0 || y >= height)
+		return false;
+	return cells[y * width + x] != 0;
+}
+
+// Greedy meshing: from the first free solid cell in row order, grow a rect
+// as wide as the row allows, then as tall as full rows of free solid cells
+// allow. Flat runs of ground come out as one rect, so most seams are gone
+// before IsInternalFace has to catch the rest.
+void TileMap::Rebuild()
+{
+	rects.clear();
+	cellRects.assign(width * height, -1);
+
+	for (int y = 0; y < height; ++y)
+	{
+		for (int x = 0; x < width; ++x)
+		{
+			if (cells[y * width + x] == 0 || cellRects[y * width + x] != -1)
+				continue;
+
+			int w = 1;
+			while (x + w < width && cells[y * width + x + w] != 0 && cellRects[y * width + x + w] == -1)
+				++w;
+
+			int h = 1;
+			for (; y + h < height; ++h)
+			{
+				int row = (y + h) * width + x;
+				bool full = true;
+				for (int i = 0; i < w && full; ++i)
+					full = cells[row + i] != 0 && cellRects[row + i] == -1;
+				if (!full)
+					break;
+			}
+
+			int index = (int)rects.size();
+			for (int j = 0; j < h; ++j)
+			{
+				for (int i = 0; i < w; ++i)
+					cellRects[(y + j) * width + x + i] = index;
+			}
+
+			TileRect rect;
+			rect.x = x;
+			rect.y = y;
+			rect.width = w;
+			rect.height = h;
+			rects.push_back(rect);
+		}
+	}
+
+	rectStamps.assign(rects.size(), 0);
+	queryStamp = 0;
+	dirty = false;
+}
+
+void TileMap::Query(std::vector<int>& results, const AABB& aabb)
+{
+	results.clear();
+	if (rects.empty())
+		return;
+
+	// In cells. The box may be far outside the grid, so it is clamped to the
+	// grid before the conversion to int.
+	Vec2 lower((aabb.lowerBound.x - origin.x) / cellSize.x, (aabb.lowerBound.y - origin.y) / cellSize.y);
+	Vec2 upper((aabb.upperBound.x - origin.x) / cellSize.x, (aabb.upperBound.y - origin.y) / cellSize.y);
+
+	if (upper.x < 0.0f || upper.y < 0.0f || lower.x >= width || lower.y >= height)
+		return;
+
+	int x1 = (int)floorf(Clamp(lower.x, 0.0f, width - 1.0f));
+	int y1 = (int)floorf(Clamp(lower.y, 0.0f, height - 1.0f));
+	int x2 = (int)floorf(Clamp(upper.x, 0.0f, width - 1.0f));
+	int y2 = (int)floorf(Clamp(upper.y, 0.0f, height - 1.0f));
+
+	// A rect covers many cells; the stamp reports it once per query.
+	++queryStamp;
+	for (int y = y1; y <= y2; ++y)
+	{
+		for (int x = x1; x <= x2; ++x)
+		{
+			int rect = cellRects[y * width + x];
+			if (rect == -1 || rectStamps[rect] == queryStamp)
+				continue;
+
+			rectStamps[rect] = queryStamp;
+			results.push_back(rect);
+		}
+	}
+}
+
+BoxTransform TileMap::GetRectTransform(int index) const
+{
+	const TileRect& rect = rects[index];
+	Vec2 size(rect.width * cellSize.x, rect.height * cellSize.y);
+
+	BoxTransform xf;
+	xf.position = origin + Vec2(rect.x * cellSize.x, rect.y * cellSize.y) + 0.5f * size;
+	xf.rotation = Mat22(Rot());
+	xf.halfWidth = 0.5f * size;
+	return xf;
+}
+
+bool TileMap::IsInternalFace(int index, const Vec2& normal, const AABB& box) const
+{
+	const TileRect& rect = rects[index];
+
+	// The row or column of cells beyond the face the normal points out of,
+	// and the box's span along that face.
+	bool side = Abs(normal.x) > Abs(normal.y);
+	int beyond;
+	float lower, upper, start, size;
+	int first, last;
+	if (side)
+	{
+		beyond = normal.x > 0.0f ? rect.x + rect.width : rect.x - 1;
+		lower = box.lowerBound.y;
+		upper = box.upperBound.y;
+		start = origin.y;
+		size = cellSize.y;
+		first = rect.y;
+		last = rect.y + rect.height - 1;
+	}
+	else
+	{
+		beyond = normal.y > 0.0f ? rect.y + rect.height : rect.y - 1;
+		lower = box.lowerBound.x;
+		upper = box.upperBound.x;
+		start = origin.x;
+		size = cellSize.x;
+		first = rect.x;
+		last = rect.x + rect.width - 1;
+	}
+
+	// The span less the slop, in cells and clamped onto the face before
+	// the conversion to int. A box smaller than the slop keeps its middle.
+	float lo = lower + k_tileSlop;
+	float hi = upper - k_tileSlop;
+	if (lo > hi)
+		lo = hi = 0.5f * (lower + upper);
+
+	int c1 = (int)floorf(Clamp((lo - start) / size, (float)first, (float)last));
+	int c2 = (int)floorf(Clamp((hi - start) / size, (float)first, (float)last));
+
+	for (int c = c1; c <= c2; ++c)
+	{
+		if (!(side ? IsSolid(beyond, c) : IsSolid(c, beyond)))
+			return false;
+	}
+
+	return true;
+}
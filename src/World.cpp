@@ -9,83 +9,1189 @@
 * It is provided "as is" without express or implied warranty.
 */
 
+#include <thread>
+#include <algorithm>
+
 #include "box2d-lite/World.h"
 #include "box2d-lite/Body.h"
 #include "box2d-lite/Joint.h"
 
-using std::vector;
-using std::map;
-using std::pair;
+using std::vector;
+using std::map;
+using std::pair;
+
+typedef map<ArbiterKey, Arbiter>::iterator ArbIter;
+typedef pair<ArbiterKey, Arbiter> ArbPair;
+typedef map<ArbiterKey, SeparatedPair>::iterator SepIter;
+typedef std::set<ArbiterKey>::iterator SensorIter;
+
+bool World::accumulateImpulses = true;
+bool World::warmStarting = true;
+bool World::positionCorrection = true;
+bool World::speculativeContacts = false;
+bool World::softStep = false;
+bool World::blockSolver = false;
+bool World::splitImpulse = false;
+bool World::manifoldCaching = false;
+bool World::Moter = true;
+
+// Speculative contacts: widen the contact distance by how far the pair can
+// close during this step, so fast bodies cannot tunnel. The soft step reuses
+// one narrowphase for all sub-steps, so it always needs them.
+static const float k_speculativeDistance = 0.04f;
+
+// Room a proxy has to move before the broadphase tree is updated.
+static const float k_aabbExtension = 0.1f;
+
+static AABB ComputeAABB(const BoxTransform& xf)
+{
+	Vec2 h = Abs(xf.rotation) * xf.halfWidth;
+	return AABB(xf.position - h, xf.position + h);
+}
+
+World::~World()
+{
+	if (worker.joinable())
+	{
+		{
+			std::lock_guard<std::mutex> lock(asyncMutex);
+			quit = true;
+		}
+		asyncCondition.notify_all();
+		worker.join();
+	}
+}
+
+// Records which box of its body a new proxy stands for.
+static void SetProxyBox(vector<int>& proxyBoxes, const DynamicTree& tree, int proxyId, int box)
+{
+	if (proxyBoxes.size() < tree.nodes.size())
+		proxyBoxes.resize(tree.nodes.size(), -1);
+	proxyBoxes[proxyId] = box;
+}
+
+void World::Add(Body* body)
+{
+	body->SyncRotation();
+
+	int index = (int)bodies.size();
+	BoxTransform xf(body);
+	if (body->boxes.empty())
+	{
+		body->proxyId = tree.CreateProxy(Fatten(ComputeAABB(xf), k_aabbExtension), index);
+		SetProxyBox(proxyBoxes, tree, body->proxyId, -1);
+	}
+	else
+	{
+		for (int i = 0; i < (int)body->boxes.size(); ++i)
+		{
+			BoxShape& box = body->boxes[i];
+			box.proxyId = tree.CreateProxy(Fatten(ComputeAABB(BoxTransform(xf, box)), k_aabbExtension), index);
+			SetProxyBox(proxyBoxes, tree, box.proxyId, i);
+		}
+		body->proxyId = body->boxes[0].proxyId;
+	}
+
+	body->previousPosition = body->position;
+	body->previousRotation = body->rotation;
+	bodies.push_back(body);
+}
+
+void World::Add(Joint* joint)
+{
+	joint->index = (int)joints.size();
+	joints.push_back(joint);
+}
+
+void World::Clear()
+{
+	// The pair maps are keyed by proxyId, so empty them first.
+	arbiters.clear();
+	separatedPairs.clear();
+	sensorPairs.clear();
+
+	for (int i = 0; i < (int)bodies.size(); ++i)
+	{
+		bodies[i]->proxyId = DynamicTree::NULL_NODE;
+		for (int j = 0; j < (int)bodies[i]->boxes.size(); ++j)
+			bodies[i]->boxes[j].proxyId = DynamicTree::NULL_NODE;
+	}
+	for (int i = 0; i < (int)joints.size(); ++i)
+		joints[i]->index = -1;
+
+	bodies.clear();
+	joints.clear();
+	ClearEvents();
+	removedBodies.clear();
+	removedJoints.clear();
+	proxyBoxes.clear();
+	tree.Clear();
+	tiles.Clear();
+}
+
+void World::Remove(Body* body)
+{
+	removedBodies.push_back(body);
+}
+
+void World::Remove(Joint* joint)
+{
+	removedJoints.push_back(joint);
+}
+
+static SensorEvent MakeSensorEvent(const ArbiterKey& key)
+{
+	SensorEvent event;
+	event.sensor = key.body1->isSensor ? key.body1 : key.body2;
+	event.visitor = key.body1->isSensor ? key.body2 : key.body1;
+	return event;
+}
+
+static ContactEvent MakeContactEvent(const ArbiterKey& key)
+{
+	ContactEvent event;
+	event.body1 = key.body1;
+	event.body2 = key.body2;
+	return event;
+}
+
+// Moves the last joint into the hole.
+static void RemoveJointAt(vector<Joint*>& joints, int index)
+{
+	Joint* joint = joints[index];
+	Joint* last = joints.back();
+	joints[index] = last;
+	last->index = index;
+	joints.pop_back();
+	joint->index = -1;
+}
+
+void World::ApplyRemovals()
+{
+	for (int i = 0; i < (int)removedJoints.size(); ++i)
+	{
+		// Skip joints removed twice or never added.
+		if (removedJoints[i]->index != -1)
+			RemoveJointAt(joints, removedJoints[i]->index);
+	}
+	removedJoints.clear();
+
+	if (removedBodies.empty())
+		return;
+
+	// Swap-remove each body, in the order they were queued. The tree's user
+	// data is the body index, so the moved body only needs its proxies
+	// pointed at the new slot. proxyId keeps its value until the end: the
+	// pair maps are ordered by it.
+	std::set<Body*> dead;
+	for (int i = 0; i < (int)removedBodies.size(); ++i)
+	{
+		Body* body = removedBodies[i];
+		if (body->proxyId == DynamicTree::NULL_NODE || body->proxyId == TileMap::TILE_PROXY)
+			continue;
+
+		// Skip bodies removed twice.
+		if (!dead.insert(body).second)
+			continue;
+
+		int index = tree.GetUserData(body->proxyId);
+		Body* last = bodies.back();
+		bodies[index] = last;
+		if (last->boxes.empty())
+		{
+			tree.SetUserData(last->proxyId, index);
+		}
+		else
+		{
+			for (int j = 0; j < (int)last->boxes.size(); ++j)
+				tree.SetUserData(last->boxes[j].proxyId, index);
+		}
+		bodies.pop_back();
+
+		if (body->boxes.empty())
+		{
+			tree.DestroyProxy(body->proxyId);
+		}
+		else
+		{
+			for (int j = 0; j < (int)body->boxes.size(); ++j)
+			{
+				tree.DestroyProxy(body->boxes[j].proxyId);
+				body->boxes[j].proxyId = DynamicTree::NULL_NODE;
+			}
+		}
+	}
+	removedBodies.clear();
+
+	if (dead.empty())
+		return;
+
+	// One sweep drops everything that refers to a removed body, however many
+	// bodies went at once.
+	for (ArbIter arb = arbiters.begin(); arb != arbiters.end();)
+	{
+		if (dead.count(arb->first.body1) > 0 || dead.count(arb->first.body2) > 0)
+		{
+			contactEndEvents.push_back(MakeContactEvent(arb->first));
+			arbiters.erase(arb++);
+		}
+		else
+		{
+			++arb;
+		}
+	}
+
+	for (SepIter sep = separatedPairs.begin(); sep != separatedPairs.end();)
+	{
+		if (dead.count(sep->first.body1) > 0 || dead.count(sep->first.body2) > 0)
+			separatedPairs.erase(sep++);
+		else
+			++sep;
+	}
+
+	for (SensorIter sensor = sensorPairs.begin(); sensor != sensorPairs.end();)
+	{
+		if (dead.count(sensor->body1) > 0 || dead.count(sensor->body2) > 0)
+		{
+			sensorEndEvents.push_back(MakeSensorEvent(*sensor));
+			sensorPairs.erase(sensor++);
+		}
+		else
+		{
+			++sensor;
+		}
+	}
+
+	for (int i = 0; i < (int)joints.size();)
+	{
+		if (dead.count(joints[i]->body1) > 0 || dead.count(joints[i]->body2) > 0)
+			RemoveJointAt(joints, i);
+		else
+			++i;
+	}
+
+	// Out of the world now; they may be added again.
+	for (std::set<Body*>::iterator body = dead.begin(); body != dead.end(); ++body)
+		(*body)->proxyId = DynamicTree::NULL_NODE;
+}
+
+// Collects the tree proxies the fat AABB of one of a body's proxies overlaps.
+struct PairQuery
+{
+	bool QueryCallback(int proxyId)
+	{
+		PairCandidate candidate;
+		candidate.body = tree->GetUserData(proxyId);
+		candidate.proxy1 = proxy;
+		candidate.proxy2 = proxyId;
+		candidates->push_back(candidate);
+		return true;
+	}
+
+	const DynamicTree* tree;
+	int proxy;
+	vector<PairCandidate>* candidates;
+};
+
+static bool CandidateLess(const PairCandidate& a, const PairCandidate& b)
+{
+	if (a.body != b.body)
+		return a.body < b.body;
+	if (a.proxy1 != b.proxy1)
+		return a.proxy1 < b.proxy1;
+	return a.proxy2 < b.proxy2;
+}
+
+// Moves a proxy whose box left its fat AABB.
+static void SyncProxy(DynamicTree& tree, int proxyId, const AABB& aabb)
+{
+	if (!tree.GetFatAABB(proxyId).Contains(aabb))
+	{
+		tree.MoveProxy(proxyId, Fatten(aabb, k_aabbExtension));
+	}
+}
+
+// Keeps the deepest points when a compound pair has more than fit.
+static void AddDeepest(Contact* contacts, int& count, const Contact& contact)
+{
+	if (count < Arbiter::MAX_POINTS)
+	{
+		contacts[count++] = contact;
+		return;
+	}
+
+	int shallowest = 0;
+	for (int i = 1; i < count; ++i)
+	{
+		if (contacts[i].separation > contacts[shallowest].separation)
+			shallowest = i;
+	}
+
+	if (contact.separation < contacts[shallowest].separation)
+		contacts[shallowest] = contact;
+}
+
+// Moves a contact anchor from a box frame to its body frame.
+static Vec2 BoxToBody(const Body* body, int box, const Vec2& anchor)
+{
+	if (box < 0)
+		return anchor;
+
+	const BoxShape& shape = body->boxes[box];
+	return shape.position + Mat22(shape.rot) * anchor;
+}
+
+BoxTransform World::GetProxyBox(int proxyId) const
+{
+	const Body* body = bodies[tree.GetUserData(proxyId)];
+	int box = proxyBoxes[proxyId];
+	if (box < 0)
+		return BoxTransform(body);
+
+	return BoxTransform(BoxTransform(body), body->boxes[box]);
+}
+
+// Same as GetProxyBox from the poses taken at the start of BroadPhase.
+BoxTransform World::PairBox(int proxyId, int bodyIndex) const
+{
+	int box = proxyBoxes[proxyId];
+	if (box < 0)
+		return transforms[bodyIndex];
+
+	return BoxTransform(transforms[bodyIndex], bodies[bodyIndex]->boxes[box]);
+}
+
+bool World::ProxiesOverlap(const Body* b1, const Body* b2) const
+{
+	int count1 = b1->boxes.empty() ? 1 : (int)b1->boxes.size();
+	int count2 = b2->boxes.empty() ? 1 : (int)b2->boxes.size();
+
+	for (int i = 0; i < count1; ++i)
+	{
+		int proxy1 = b1->boxes.empty() ? b1->proxyId : b1->boxes[i].proxyId;
+		for (int j = 0; j < count2; ++j)
+		{
+			int proxy2 = b2->boxes.empty() ? b2->proxyId : b2->boxes[j].proxyId;
+			if (TestOverlap(tree.GetFatAABB(proxy1), tree.GetFatAABB(proxy2)))
+				return true;
+		}
+	}
+
+	return false;
+}
+
+// Clips each overlapping box pair of a pair that involves a compound body
+// and merges the points into one arbiter. index1 and the candidates' proxy1
+// belong to key.body1.
+void World::CollideCompound(const ArbiterKey& key, const PairCandidate* pairs, int count, int index1, int index2, float margin)
+{
+	Body* b1 = key.body1;
+	Body* b2 = key.body2;
+
+	Contact contacts[Arbiter::MAX_POINTS];
+	int numContacts = 0;
+
+	// Removed (broken) bodies touch nothing.
+	if (b1->isItExist && b2->isItExist)
+	{
+		for (int k = 0; k < count; ++k)
+		{
+			int box1 = proxyBoxes[pairs[k].proxy1];
+			int box2 = proxyBoxes[pairs[k].proxy2];
+
+			Contact boxContacts[2];
+			int boxCount = CollideBoxes(boxContacts, PairBox(pairs[k].proxy1, index1), PairBox(pairs[k].proxy2, index2), margin);
+			++profile.narrowphaseCalls;
+
+			for (int p = 0; p < boxCount; ++p)
+			{
+				Contact& c = boxContacts[p];
+				c.localAnchor1 = BoxToBody(b1, box1, c.localAnchor1);
+				c.localAnchor2 = BoxToBody(b2, box2, c.localAnchor2);
+				c.childPair = ((box1 + 1) << 16) | (box2 + 1);
+				AddDeepest(contacts, numContacts, c);
+			}
+		}
+	}
+
+	UpdateMergedArbiter(key, contacts, numContacts);
+}
+
+// Collides each box of a dynamic body with the tile rects under it. Contacts
+// on rect faces that are covered by other tiles are ghosts of the seams
+// between rects and are dropped, so boxes slide across flat ground.
+void World::CollideTiles(int index, float margin)
+{
+	Body* b = bodies[index];
+
+	Contact contacts[Arbiter::MAX_POINTS];
+	int numContacts = 0;
+
+	int boxCount = b->boxes.empty() ? 1 : (int)b->boxes.size();
+	for (int k = 0; k < boxCount; ++k)
+	{
+		int box = b->boxes.empty() ? -1 : k;
+		BoxTransform xf = box < 0 ? transforms[index] : BoxTransform(transforms[index], b->boxes[box]);
+
+		AABB aabb = ComputeAABB(xf);
+		tiles.Query(tileRects, Fatten(aabb, margin));
+		for (int r = 0; r < (int)tileRects.size(); ++r)
+		{
+			int rect = tileRects[r];
+			BoxTransform rectXf = tiles.GetRectTransform(rect);
+
+			Contact rectContacts[2];
+			int rectCount = CollideBoxes(rectContacts, rectXf, xf, margin);
+			++profile.tileRectTests;
+
+			for (int p = 0; p < rectCount; ++p)
+			{
+				// A contact deeper than the slop is never dropped: whatever
+				// face it is on, the box has to come out.
+				Contact& c = rectContacts[p];
+				if (c.separation > -k_tileSlop && tiles.IsInternalFace(rect, c.normal, aabb))
+				{
+					++profile.tileFaceRejects;
+					continue;
+				}
+
+				// The tile body sits at the origin, unrotated.
+				c.localAnchor1 = rectXf.position + c.localAnchor1;
+				c.localAnchor2 = BoxToBody(b, box, c.localAnchor2);
+				c.childPair = ((rect + 1) << 16) | (box + 1);
+				AddDeepest(contacts, numContacts, c);
+			}
+		}
+	}
+
+	UpdateMergedArbiter(ArbiterKey(&tiles.body, b), contacts, numContacts);
+}
+
+// Creates, updates or destroys the arbiter of a pair whose contacts were
+// gathered from several box pairs.
+void World::UpdateMergedArbiter(const ArbiterKey& key, Contact* contacts, int numContacts)
+{
+	ArbIter iter = arbiters.find(key);
+	if (numContacts == 0)
+	{
+		if (iter != arbiters.end())
+		{
+			contactEndEvents.push_back(MakeContactEvent(key));
+			arbiters.erase(iter);
+		}
+		return;
+	}
+
+	if (iter == arbiters.end())
+	{
+		iter = arbiters.insert(ArbPair(key, Arbiter(key, contacts, numContacts))).first;
+		contactBeginEvents.push_back(MakeContactEvent(key));
+	}
+	else
+	{
+		iter->second.Update(contacts, numContacts);
+	}
+
+	iter->second.compound = true;
+	iter->second.visited = true;
+}
+
+static bool ShouldCollide(const Body* b1, const Body* b2)
+{
+	if (b1->groupIndex == b2->groupIndex && b1->groupIndex != 0)
+		return b1->groupIndex > 0;
+
+	return (b1->maskBits & b2->categoryBits) != 0 && (b1->categoryBits & b2->maskBits) != 0;
+}
+
+static pair<Body*, Body*> JointedPair(Body* b1, Body* b2)
+{
+	return b1 < b2 ? pair<Body*, Body*>(b1, b2) : pair<Body*, Body*>(b2, b1);
+}
+
+void World::UpdateSensorPair(Body* b1, Body* b2, bool touching)
+{
+	ArbiterKey key(b1, b2);
+
+	SensorIter sensor = sensorPairs.find(key);
+	bool wasTouching = sensor != sensorPairs.end();
+	if (touching == wasTouching)
+		return;
+
+	if (touching)
+	{
+		sensorPairs.insert(key);
+		sensorBeginEvents.push_back(MakeSensorEvent(key));
+	}
+	else
+	{
+		sensorPairs.erase(sensor);
+		sensorEndEvents.push_back(MakeSensorEvent(key));
+	}
+}
+
+void World::BroadPhase(float dt)
+{
+	bool speculative = speculativeContacts || softStep;
+	int n = (int)bodies.size();
+
+	// Evaluate each body's rotation once for all of its pairs, and move the
+	// proxies whose bodies left their fat AABB. The AABB in the tree covers
+	// half the speculative distance plus the body's own motion, so two
+	// proxies overlap whenever the pair could get within its margin.
+	// Compound bodies move one proxy per box; static ones are left alone.
+	transforms.resize(n);
+	bool anyCompound = false;
+	bool anySensor = false;
+
+	if (tiles.dirty)
+		tiles.Rebuild();
+
+	// Tile arbiters sort first, since the tile body precedes every proxy.
+	bool anyTiles = !tiles.rects.empty() || (!arbiters.empty() && arbiters.begin()->first.body1 == &tiles.body);
+	for (int i = 0; i < n; ++i)
+	{
+		Body* b = bodies[i];
+		transforms[i] = BoxTransform(b);
+		anySensor = anySensor || b->isSensor;
+
+		float extension = 0.0f;
+		if (speculative)
+		{
+			float r = 0.5f * b->width.Length();
+			extension = 0.5f * k_speculativeDistance + dt * (b->velocity.Length() + Abs(b->angularVelocity) * r);
+		}
+
+		if (b->boxes.empty())
+		{
+			SyncProxy(tree, b->proxyId, Fatten(ComputeAABB(transforms[i]), extension));
+			continue;
+		}
+
+		anyCompound = true;
+		if (b->type == STATIC_BODY)
+			continue;
+
+		for (int j = 0; j < (int)b->boxes.size(); ++j)
+		{
+			const BoxShape& box = b->boxes[j];
+			SyncProxy(tree, box.proxyId, Fatten(ComputeAABB(BoxTransform(transforms[i], box)), extension));
+		}
+	}
+
+	// Pairs whose proxies stopped overlapping are no longer visited, so drop
+	// their arbiters and cached gaps here. Compound arbiters are dropped
+	// after the pairs are visited instead.
+	for (ArbIter arb = arbiters.begin(); arb != arbiters.end();)
+	{
+		if (arb->second.compound || TestOverlap(tree.GetFatAABB(arb->first.body1->proxyId), tree.GetFatAABB(arb->first.body2->proxyId)))
+		{
+			++arb;
+		}
+		else
+		{
+			contactEndEvents.push_back(MakeContactEvent(arb->first));
+			arbiters.erase(arb++);
+		}
+	}
+
+	for (SepIter sep = separatedPairs.begin(); sep != separatedPairs.end();)
+	{
+		if (TestOverlap(tree.GetFatAABB(sep->first.body1->proxyId), tree.GetFatAABB(sep->first.body2->proxyId)))
+			++sep;
+		else
+			separatedPairs.erase(sep++);
+	}
+
+	for (SensorIter sensor = sensorPairs.begin(); sensor != sensorPairs.end();)
+	{
+		if (ProxiesOverlap(sensor->body1, sensor->body2))
+		{
+			++sensor;
+		}
+		else
+		{
+			sensorEndEvents.push_back(MakeSensorEvent(*sensor));
+			sensorPairs.erase(sensor++);
+		}
+	}
+
+	batch.Clear();
+	batchKeys.clear();
+
+	// Joints can be added, removed or switched between steps, so the pairs
+	// they keep apart are gathered again for a binary search.
+	jointedPairs.clear();
+	for (int i = 0; i < (int)joints.size(); ++i)
+	{
+		if (!joints[i]->collideConnected)
+			jointedPairs.push_back(JointedPair(joints[i]->body1, joints[i]->body2));
+	}
+	std::sort(jointedPairs.begin(), jointedPairs.end());
+
+	// Each dynamic body queries the tree, and dynamic pairs are kept only
+	// from the query of the lower index. Kinematic bodies query as well when
+	// there are sensors, but keep only their sensor pairs with static and
+	// kinematic bodies. Other pairs of static and kinematic bodies are never
+	// found.
+	for (int i = 0; i < n; ++i)
+	{
+		Body* bi = bodies[i];
+		bool kinematic = bi->type == KINEMATIC_BODY;
+
+		if (bi->type != DYNAMIC_BODY && !(kinematic && anySensor))
+			continue;
+
+		candidates.clear();
+		PairQuery query;
+		query.tree = &tree;
+		query.candidates = &candidates;
+		if (bi->boxes.empty())
+		{
+			query.proxy = bi->proxyId;
+			tree.Query(&query, tree.GetFatAABB(query.proxy));
+		}
+		else
+		{
+			for (int b = 0; b < (int)bi->boxes.size(); ++b)
+			{
+				query.proxy = bi->boxes[b].proxyId;
+				tree.Query(&query, tree.GetFatAABB(query.proxy));
+			}
+		}
+
+		// A compound body is found once per overlapping box pair. Sorting
+		// brings the box pairs of each body together.
+		if (anyCompound)
+			std::sort(candidates.begin(), candidates.end(), CandidateLess);
+
+		for (int c = 0; c < (int)candidates.size();)
+		{
+			int first = c;
+			int j = candidates[c].body;
+			while (c < (int)candidates.size() && candidates[c].body == j)
+				++c;
+
+			Body* bj = bodies[j];
+
+			if (j == i || (bj->type == DYNAMIC_BODY && (kinematic || j < i)))
+				continue;
+
+			if (kinematic && ((!bi->isSensor && !bj->isSensor) || (bj->type == KINEMATIC_BODY && j < i)))
+				continue;
+
+			++profile.broadphasePairs;
+
+			// Filtered pairs never reach the narrowphase. A pair may still have
+			// an arbiter from before its filter changed.
+			if (!ShouldCollide(bi, bj) ||
+				(!jointedPairs.empty() && std::binary_search(jointedPairs.begin(), jointedPairs.end(), JointedPair(bi, bj))))
+			{
+				++profile.filteredPairs;
+				ArbiterKey key(bi, bj);
+				if (arbiters.erase(key) > 0)
+					contactEndEvents.push_back(MakeContactEvent(key));
+				separatedPairs.erase(key);
+				if (bi->isSensor || bj->isSensor)
+					UpdateSensorPair(bi, bj, false);
+				continue;
+			}
+
+			// Sensors get an exact overlap test in place of the narrowphase.
+			if (bi->isSensor || bj->isSensor)
+			{
+				if (!bi->isSensor || !bj->isSensor)
+				{
+					bool touching = false;
+					for (int k = first; k < c && bi->isItExist && bj->isItExist && !touching; ++k)
+						touching = TestOverlapBoxes(PairBox(candidates[k].proxy1, i), PairBox(candidates[k].proxy2, j));
+					UpdateSensorPair(bi, bj, touching);
+				}
+				continue;
+			}
+
+			float margin = 0.0f;
+			if (speculative)
+			{
+				Vec2 dv = bj->velocity - bi->velocity;
+				float ri = 0.5f * bi->width.Length();
+				float rj = 0.5f * bj->width.Length();
+				margin = k_speculativeDistance + dt * (dv.Length() + Abs(bi->angularVelocity) * ri + Abs(bj->angularVelocity) * rj);
+			}
+
+			ArbiterKey key(bi, bj);
+
+			if (!bi->boxes.empty() || !bj->boxes.empty())
+			{
+				if (key.body1 != bi)
+				{
+					for (int k = first; k < c; ++k)
+						Swap(candidates[k].proxy1, candidates[k].proxy2);
+				}
+
+				CollideCompound(key, &candidates[first], c - first, key.body1 == bi ? i : j, key.body1 == bi ? j : i, margin);
+				continue;
+			}
+
+			// Pairs that were apart last time are first checked against their
+			// cached separating axis. Such pairs have no arbiter.
+			SepIter sep = separatedPairs.find(key);
+			if (sep != separatedPairs.end() && SeparationHolds(key, sep->second, margin))
+				continue;
+
+			ArbIter iter = arbiters.find(key);
+
+			// Removed (broken) bodies touch nothing.
+			if (!bi->isItExist || !bj->isItExist)
+			{
+				if (sep != separatedPairs.end())
+					separatedPairs.erase(sep);
+				if (iter != arbiters.end())
+				{
+					contactEndEvents.push_back(MakeContactEvent(key));
+					arbiters.erase(iter);
+				}
+				continue;
+			}
+
+			// Touching pairs that have barely moved relative to each other keep
+			// their manifold and skip the narrowphase.
+			if (iter != arbiters.end() && manifoldCaching)
+			{
+				if (iter->second.RefreshContacts())
+				{
+					++profile.manifoldCacheHits;
+					continue;
+				}
+
+				++profile.manifoldCacheMisses;
+			}
+
+			// Queue the pair for the narrowphase, ordered like its key.
+			if (key.body1 == bi)
+				batch.Add(transforms[i], transforms[j], margin);
+			else
+				batch.Add(transforms[j], transforms[i], margin);
+
+			batchKeys.push_back(key);
+		}
+
+		if (!tiles.rects.empty() && !kinematic && !bi->isSensor && bi->isItExist && ShouldCollide(&tiles.body, bi))
+		{
+			float margin = 0.0f;
+			if (speculative)
+			{
+				float r = 0.5f * bi->width.Length();
+				margin = k_speculativeDistance + dt * (bi->velocity.Length() + Abs(bi->angularVelocity) * r);
+			}
+
+			CollideTiles(i, margin);
+		}
+	}
+
+	// A compound or tile arbiter whose box pairs were not found has lost
+	// them all.
+	if (anyCompound || anyTiles)
+	{
+		for (ArbIter arb = arbiters.begin(); arb != arbiters.end();)
+		{
+			if (arb->second.compound && !arb->second.visited)
+			{
+				contactEndEvents.push_back(MakeContactEvent(arb->first));
+				arbiters.erase(arb++);
+			}
+			else
+			{
+				arb->second.visited = false;
+				++arb;
+			}
+		}
+	}
+
+	int count = batch.Size();
+	batchAxes.resize(count);
+	CollideBatch(manifolds, count > 0 ? &batchAxes[0] : NULL, batch);
+	profile.narrowphaseCalls += count;
+
+	// Manifolds come back packed in batch order.
+	int m = 0;
+	for (int k = 0; k < count; ++k)
+	{
+		const ArbiterKey& key = batchKeys[k];
+		const SeparatingAxis& separatingAxis = batchAxes[k];
+
+		if (separatingAxis.separation > 0.0f)
+		{
+			SeparatedPair& sp = separatedPairs[key];
+			sp.separatingAxis = separatingAxis;
+			sp.position1 = key.body1->position;
+			sp.position2 = key.body2->position;
+			sp.rotation1 = key.body1->rotation;
+			sp.rotation2 = key.body2->rotation;
+		}
+		else
+		{
+			separatedPairs.erase(key);
+		}
+
+		Manifold* manifold = NULL;
+		if (m < (int)manifolds.size() && manifolds[m].pair == k)
+			manifold = &manifolds[m++];
+
+		ArbIter iter = arbiters.find(key);
+		if (manifold)
+		{
+			if (iter == arbiters.end())
+			{
+				arbiters.insert(ArbPair(key, Arbiter(key, manifold->contacts, manifold->numContacts)));
+				contactBeginEvents.push_back(MakeContactEvent(key));
+			}
+			else
+			{
+				iter->second.Update(manifold->contacts, manifold->numContacts);
+			}
+		}
+		else if (iter != arbiters.end())
+		{
+			contactEndEvents.push_back(MakeContactEvent(key));
+			arbiters.erase(iter);
+		}
+	}
+}
+
+// Keeps the closest exact box hit. Returning the hit fraction clips the
+// ray, so the tree skips everything behind it.
+struct RayCastQuery
+{
+	float RayCastCallback(const Vec2& p1, const Vec2& p2, float maxFraction, int proxyId)
+	{
+		Body* body = world->bodies[world->tree.GetUserData(proxyId)];
+		if (!body->isItExist)
+			return -1.0f;
+
+		float fraction;
+		Vec2 normal;
+		if (!RayCastBox(&fraction, &normal, world->GetProxyBox(proxyId), p1, p2, maxFraction))
+			return -1.0f;
+
+		hit->body = body;
+		hit->fraction = fraction;
+		hit->normal = normal;
+		hit->point = p1 + fraction * (p2 - p1);
+		return fraction;
+	}
+
+	const World* world;
+	RayCastHit* hit;
+};
+
+bool World::RayCast(RayCastHit* hit, const Vec2& p1, const Vec2& p2) const
+{
+	hit->body = NULL;
+	hit->fraction = 1.0f;
+
+	RayCastQuery query;
+	query.world = this;
+	query.hit = hit;
+	tree.RayCast(&query, p1, p2, 1.0f);
+
+	return hit->body != NULL;
+}
+
+// A compound body can overlap a query with several boxes.
+static bool Reported(Body* const* results, int count, const Body* body)
+{
+	for (int i = 0; i < count; ++i)
+	{
+		if (results[i] == body)
+			return true;
+	}
+	return false;
+}
+
+// Fills the buffer with bodies whose AABB overlaps the query box.
+struct AABBQuery
+{
+	bool QueryCallback(int proxyId)
+	{
+		Body* body = world->bodies[world->tree.GetUserData(proxyId)];
+		if (!body->isItExist || !TestOverlap(ComputeAABB(world->GetProxyBox(proxyId)), *aabb))
+			return true;
 
-typedef map<ArbiterKey, Arbiter>::iterator ArbIter;
-typedef pair<ArbiterKey, Arbiter> ArbPair;
+		if (!body->boxes.empty() && Reported(results, count, body))
+			return true;
 
-bool World::accumulateImpulses = true;
-bool World::warmStarting = true;
-bool World::positionCorrection = true;
-bool World::Moter = true;
+		results[count++] = body;
+		return count < capacity;
+	}
 
-void World::Add(Body* body)
+	const World* world;
+	const AABB* aabb;
+	Body** results;
+	int capacity;
+	int count;
+};
+
+int World::QueryAABB(Body** results, int capacity, const AABB& aabb) const
 {
-	bodies.push_back(body);
+	if (capacity <= 0)
+		return 0;
+
+	AABBQuery query;
+	query.world = this;
+	query.aabb = &aabb;
+	query.results = results;
+	query.capacity = capacity;
+	query.count = 0;
+	tree.Query(&query, aabb);
+
+	return query.count;
 }
 
-void World::Add(Joint* joint)
+// Keeps the earliest exact hit of the swept box.
+struct BoxCastQuery
 {
-	joints.push_back(joint);
+	float RayCastCallback(const Vec2& p1, const Vec2& p2, float maxFraction, int proxyId)
+	{
+		Body* body = world->bodies[world->tree.GetUserData(proxyId)];
+		if (body == ignore || !body->isItExist)
+			return -1.0f;
+
+		float fraction;
+		Vec2 normal;
+		if (!BoxCastBox(&fraction, &normal, *box, p2 - p1, world->GetProxyBox(proxyId), maxFraction))
+			return -1.0f;
+
+		hit->body = body;
+		hit->fraction = fraction;
+		hit->normal = normal;
+		return fraction;
+	}
+
+	// Zero-length cast: the first overlap found is the hit.
+	bool QueryCallback(int proxyId)
+	{
+		return RayCastCallback(box->position, box->position, 1.0f, proxyId) != 0.0f;
+	}
+
+	const World* world;
+	const BoxTransform* box;
+	const Body* ignore;
+	BoxCastHit* hit;
+};
+
+bool World::BoxCast(BoxCastHit* hit, const Vec2& width, float rotation, const Vec2& p1, const Vec2& p2, const Body* ignore) const
+{
+	hit->body = NULL;
+	hit->fraction = 1.0f;
+
+	BoxTransform box;
+	box.position = p1;
+	box.rotation = Mat22(rotation);
+	box.halfWidth = 0.5f * width;
+
+	BoxCastQuery query;
+	query.world = this;
+	query.box = &box;
+	query.ignore = ignore;
+	query.hit = hit;
+
+	// The sweep needs a direction, so a box that does not move is tested
+	// in place and reports an overlap at fraction zero.
+	Vec2 extents = Abs(box.rotation) * box.halfWidth;
+	if (p1.x == p2.x && p1.y == p2.y)
+		tree.Query(&query, AABB(p1 - extents, p1 + extents));
+	else
+		tree.SweepAABB(&query, p1, p2, extents, 1.0f);
+
+	return hit->body != NULL;
 }
 
-void World::Clear()
+// Fills the buffer with bodies the box overlaps.
+struct BoxOverlapQuery
 {
-	bodies.clear();
-	joints.clear();
-	arbiters.clear();
+	bool QueryCallback(int proxyId)
+	{
+		Body* body = world->bodies[world->tree.GetUserData(proxyId)];
+		if (body == ignore || !body->isItExist || !TestOverlapBoxes(*box, world->GetProxyBox(proxyId)))
+			return true;
+
+		if (!body->boxes.empty() && Reported(results, count, body))
+			return true;
+
+		results[count++] = body;
+		return count < capacity;
+	}
+
+	const World* world;
+	const BoxTransform* box;
+	const Body* ignore;
+	Body** results;
+	int capacity;
+	int count;
+};
+
+int World::OverlapBox(Body** results, int capacity, const Vec2& width, float rotation, const Vec2& position, const Body* ignore) const
+{
+	if (capacity <= 0)
+		return 0;
+
+	BoxTransform box;
+	box.position = position;
+	box.rotation = Mat22(rotation);
+	box.halfWidth = 0.5f * width;
+
+	BoxOverlapQuery query;
+	query.world = this;
+	query.box = &box;
+	query.ignore = ignore;
+	query.results = results;
+	query.capacity = capacity;
+	query.count = 0;
+	tree.Query(&query, ComputeAABB(box));
+
+	return query.count;
 }
 
-void World::BroadPhase()
+struct RayCastBatchContext
 {
-	// O(n^2) broad-phase
-	for (int i = 0; i < (int)bodies.size(); ++i)
+	const World* world;
+	RayCastHit* hits;
+	const RayCastInput* rays;
+};
+
+static void RayCastRange(int begin, int end, void* taskContext)
+{
+	RayCastBatchContext* context = (RayCastBatchContext*)taskContext;
+	for (int i = begin; i < end; ++i)
 	{
-		Body* bi = bodies[i];
+		context->world->RayCast(context->hits + i, context->rays[i].p1, context->rays[i].p2);
+	}
+}
 
-		for (int j = i + 1; j < (int)bodies.size(); ++j)
-		{
-			Body* bj = bodies[j];
+void World::RayCastBatch(RayCastHit* hits, const RayCastInput* rays, int count, RangeScheduler* schedule, void* userContext) const
+{
+	RayCastBatchContext context;
+	context.world = this;
+	context.hits = hits;
+	context.rays = rays;
 
-			if (bi->invMass == 0.0f && bj->invMass == 0.0f)
-				continue;
+	if (schedule == NULL)
+		RayCastRange(0, count, &context);
+	else
+		schedule(RayCastRange, &context, count, userContext);
+}
 
-			Arbiter newArb(bi, bj);
-			ArbiterKey key(bi, bj);
+// Returns true if a separated pair is known to still be apart. The motion
+// of each body since the gap was measured is bounded by its displacement
+// plus rotation times its radius. While the sum stays below the gap the
+// pair cannot be touching. Otherwise the cached axis is tested alone, and
+// only if that fails does the pair go through Collide() again.
+bool World::SeparationHolds(const ArbiterKey& key, SeparatedPair& sp, float margin)
+{
+	Body* b1 = key.body1;
+	Body* b2 = key.body2;
 
-			if (newArb.numContacts > 0)
-			{
-				ArbIter iter = arbiters.find(key);
-				if (iter == arbiters.end())
-				{
-					arbiters.insert(ArbPair(key, newArb));
-				}
-				else
-				{
-					iter->second.Update(newArb.contacts, newArb.numContacts);
-				}
-			}
-			else
-			{
-				arbiters.erase(key);
-			}
+	float motion = (b1->position - sp.position1).Length() + Abs(b1->rotation - sp.rotation1) * 0.5f * b1->width.Length();
+	motion += (b2->position - sp.position2).Length() + Abs(b2->rotation - sp.rotation2) * 0.5f * b2->width.Length();
+
+	if (motion < sp.separatingAxis.separation - margin)
+	{
+		++profile.separatedPairSkips;
+		return true;
+	}
+
+	float separation = SeparationOnAxis(b1, b2, sp.separatingAxis.axis);
+	if (separation > margin)
+	{
+		sp.separatingAxis.separation = separation;
+		sp.position1 = b1->position;
+		sp.position2 = b2->position;
+		sp.rotation1 = b1->rotation;
+		sp.rotation2 = b2->rotation;
+		++profile.separatingAxisHits;
+		return true;
+	}
+
+	return false;
+}
+
+int World::Advance(float elapsedTime)
+{
+	// The events of all steps taken here add up, and a call that takes no
+	// step leaves none behind.
+	ClearEvents();
+	accumulator += elapsedTime;
+
+	int steps = 0;
+	while (accumulator >= fixedTimeStep && steps < maxFixedSteps)
+	{
+		for (int i = 0; i < (int)bodies.size(); ++i)
+		{
+			bodies[i]->previousPosition = bodies[i]->position;
+			bodies[i]->previousRotation = bodies[i]->rotation;
 		}
+
+		Simulate(fixedTimeStep);
+		accumulator -= fixedTimeStep;
+		++steps;
 	}
+
+	// Spiral of death: drop the time the capped steps could not cover.
+	if (accumulator >= fixedTimeStep)
+		accumulator = fmodf(accumulator, fixedTimeStep);
+
+	interpolationAlpha = fixedTimeStep > 0.0f ? accumulator / fixedTimeStep : 1.0f;
+	return steps;
+}
+
+void World::GetInterpolatedTransform(const Body* body, Vec2* position, float* rotation) const
+{
+	float alpha = interpolationAlpha;
+	*position = body->previousPosition + alpha * (body->position - body->previousPosition);
+	*rotation = body->previousRotation + alpha * (body->rotation - body->previousRotation);
+}
+
+void World::ClearEvents()
+{
+	sensorBeginEvents.clear();
+	sensorEndEvents.clear();
+	contactBeginEvents.clear();
+	contactEndEvents.clear();
+	contactHitEvents.clear();
 }
 
 void World::Step(float dt)
 {
 	//printf("debug - step \n");
+	interpolationAlpha = 1.0f;
+
+	ClearEvents();
+	Simulate(dt);
+}
+
+void World::Simulate(float dt)
+{
+	ApplyRemovals();
+
+	// Pick up rotations written directly since the last step.
+	for (int i = 0; i < (int)bodies.size(); ++i)
+		bodies[i]->SyncRotation();
+
+	if (softStep)
+	{
+		SoftStep(dt);
+		GatherHitEvents();
+		ApplyRemovals();
+		return;
+	}
+
 	float inv_dt = dt > 0.0f ? 1.0f / dt : 0.0f;
 
+	profile = Profile();
+
 	// Determine overlapping bodies and update contact points.
-	BroadPhase();
+	BroadPhase(dt);
 
 	// Integrate forces.
 	for (int i = 0; i < (int)bodies.size(); ++i)
@@ -93,7 +1199,7 @@ void World::Step(float dt)
 		//printf("debug - step-force \n");
 		Body* b = bodies[i];
 
-		if (b->invMass == 0.0f)
+		if (b->type != DYNAMIC_BODY)
 			continue;
 
 		//Vec2 TestFor_oldVelocity = b->velocity; // DEBUG
@@ -121,26 +1227,74 @@ void World::Step(float dt)
 		joints[i]->PreStep(inv_dt);	
 	}
 
-	// Perform iterations
-	for (int i = 0; i < iterations; ++i)
+	// Perform iterations. Stop early once a pass changes no velocity by more
+	// than the tolerance.
+	bool converged = false;
+	for (int i = 0; i < iterations && !converged; ++i)
 	{
+		float maxDelta = 0.0f;
+
 		for (ArbIter arb = arbiters.begin(); arb != arbiters.end(); ++arb)
 		{
-			//Body* dummy[2]; // ʱȭ ʾҽϴ.
 			//arb->second.ApplyImpulse();
-			//Body** deadBodyStorage = {NULL,};
-			arb->second.ApplyImpulse(deadBodyStorage,200);
+			arb->second.solveDelta = arb->second.ApplyImpulse(deadBodyStorage,200);
+			maxDelta = Max(maxDelta, arb->second.solveDelta);
+		}
+
+		for (int j = 0; j < (int)joints.size(); ++j)
+		{
+			joints[j]->solveDelta = joints[j]->ApplyImpulse();
+			maxDelta = Max(maxDelta, joints[j]->solveDelta);
+		}
+
+		++profile.iterations;
+		converged = maxDelta < convergenceTolerance;
+	}
+
+	// Extra passes up to the hard cap, only over the constraints that were
+	// still changing in the previous pass.
+	for (int i = iterations; i < maxIterations && !converged; ++i)
+	{
+		float maxDelta = 0.0f;
 
-			// ⼭ ޸𸮸 
-			//arb->second.ApplyImpulse(&deadBodyStorage[0],200);
+		for (ArbIter arb = arbiters.begin(); arb != arbiters.end(); ++arb)
+		{
+			if (arb->second.solveDelta < convergenceTolerance)
+				continue;
+
+			arb->second.solveDelta = arb->second.ApplyImpulse(deadBodyStorage,200);
+			maxDelta = Max(maxDelta, arb->second.solveDelta);
 		}
 
 		for (int j = 0; j < (int)joints.size(); ++j)
 		{
-			joints[j]->ApplyImpulse();
+			if (joints[j]->solveDelta < convergenceTolerance)
+				continue;
+
+			joints[j]->solveDelta = joints[j]->ApplyImpulse();
+			maxDelta = Max(maxDelta, joints[j]->solveDelta);
 		}
+
+		++profile.extraIterations;
+		converged = maxDelta < convergenceTolerance;
 	}
 
+	// Split impulse: separate penetrating bodies with pseudo velocities that
+	// only move positions, so position correction adds no kinetic energy.
+	if (splitImpulse)
+	{
+		for (int i = 0; i < positionIterations; ++i)
+		{
+			float maxDelta = 0.0f;
+
+			for (ArbIter arb = arbiters.begin(); arb != arbiters.end(); ++arb)
+				maxDelta = Max(maxDelta, arb->second.ApplyPositionImpulse());
+
+			++profile.positionIterations;
+			if (maxDelta < convergenceTolerance)
+				break;
+		}
+	}
 
 
 	// Integrate Velocities
@@ -148,11 +1302,17 @@ void World::Step(float dt)
 	{
 		Body* b = bodies[i];
 
+		// Kinematic bodies move by their velocity, static bodies stay put.
+		if (b->type == STATIC_BODY)
+			continue;
+
 		Vec2 TestFor_OldPosition = b->position;
 
-		b->position += dt * b->velocity;
-		b->rotation += dt * b->angularVelocity;
-		
+		b->position += dt * (b->velocity + b->biasVelocity);
+		b->Rotate(dt * (b->angularVelocity + b->biasAngularVelocity));
+
+		b->biasVelocity.Set(0.0f, 0.0f);
+		b->biasAngularVelocity = 0.0f;
 
 		//if((b->position == TestFor_OldPosition) && !(b->velocity.x == 0 && b->velocity.y == 0)) { printf("ERROR - B->position change did not worked. \n"); }
 
@@ -162,6 +1322,274 @@ void World::Step(float dt)
 
 	//Break Block
 	for (int i = 0; i < 200; i++) {
+		if (deadBodyStorage[i] != NULL)
+			Remove(deadBodyStorage[i]);
+		deadBodyStorage[i] = NULL;
+	}
+
+	GatherHitEvents();
+	ApplyRemovals();
+}
+
+// One pass over the arbiters after the solver, so the solver loops carry no
+// event bookkeeping.
+void World::GatherHitEvents()
+{
+	if (hitImpulseThreshold <= 0.0f)
+		return;
+
+	for (ArbIter arb = arbiters.begin(); arb != arbiters.end(); ++arb)
+	{
+		const Arbiter& arbiter = arb->second;
+
+		int strongest = -1;
+		float maxImpulse = hitImpulseThreshold;
+		for (int i = 0; i < arbiter.numContacts; ++i)
+		{
+			if (arbiter.contacts[i].Pn > maxImpulse)
+			{
+				maxImpulse = arbiter.contacts[i].Pn;
+				strongest = i;
+			}
+		}
+
+		if (strongest == -1)
+			continue;
+
+		ContactHitEvent event;
+		event.body1 = arbiter.body1;
+		event.body2 = arbiter.body2;
+		event.point = arbiter.contacts[strongest].position;
+		event.normal = arbiter.contacts[strongest].normal;
+		event.impulse = maxImpulse;
+		contactHitEvents.push_back(event);
+	}
+}
+
+// Sub-stepping solver with soft contacts. The narrowphase runs once, then
+// each sub-step integrates velocities, solves with soft bias, integrates
+// positions and relaxes. One pass per sub-step replaces the iteration loop.
+void World::SoftStep(float dt)
+{
+	const float k_contactDampingRatio = 10.0f;
+
+	profile = Profile();
+
+	float h = subSteps > 0 ? dt / subSteps : 0.0f;
+	float inv_h = h > 0.0f ? 1.0f / h : 0.0f;
+
+	BroadPhase(dt);
+
+	// Make the contacts as stiff as the sub-step rate allows. Softer contacts
+	// let tall stacks lean over.
+	float contactHertz = 0.25f * inv_h;
+	Softness contactSoftness(contactHertz, k_contactDampingRatio, h);
+
+	for (ArbIter arb = arbiters.begin(); arb != arbiters.end(); ++arb)
+	{
+		arb->second.PreStepSoft();
+	}
+
+	for (int step = 0; step < subSteps; ++step)
+	{
+		// Integrate forces.
+		for (int i = 0; i < (int)bodies.size(); ++i)
+		{
+			Body* b = bodies[i];
+
+			if (b->type != DYNAMIC_BODY)
+				continue;
+
+			b->velocity += h * (gravity + b->invMass * b->force);
+			b->angularVelocity += h * b->invI * b->torque;
+
+			if (b->isItExist == false)
+			{
+				b->velocity.Set(0, 0);
+				b->angularVelocity = 0.0f;
+			}
+		}
+
+		for (ArbIter arb = arbiters.begin(); arb != arbiters.end(); ++arb)
+		{
+			arb->second.WarmStart();
+		}
+
+		for (int i = 0; i < (int)joints.size(); ++i)
+		{
+			joints[i]->PreStep(inv_h);
+		}
+
+		for (ArbIter arb = arbiters.begin(); arb != arbiters.end(); ++arb)
+		{
+			arb->second.ApplySoftImpulse(inv_h, contactSoftness, true);
+		}
+
+		for (int j = 0; j < (int)joints.size(); ++j)
+		{
+			joints[j]->ApplyImpulse();
+		}
+
+		// Integrate velocities.
+		for (int i = 0; i < (int)bodies.size(); ++i)
+		{
+			Body* b = bodies[i];
+
+			if (b->type == STATIC_BODY)
+				continue;
+
+			b->position += h * b->velocity;
+			b->Rotate(h * b->angularVelocity);
+		}
+
+		// Relax
+		for (ArbIter arb = arbiters.begin(); arb != arbiters.end(); ++arb)
+		{
+			arb->second.ApplySoftImpulse(inv_h, contactSoftness, false);
+		}
+
+		profile.iterations += 2;
+	}
+
+	for (ArbIter arb = arbiters.begin(); arb != arbiters.end(); ++arb)
+	{
+		arb->second.CheckImpulseLimit(deadBodyStorage, 200);
+	}
+
+	for (int i = 0; i < (int)bodies.size(); ++i)
+	{
+		bodies[i]->force.Set(0.0f, 0.0f);
+		bodies[i]->torque = 0.0f;
+	}
+
+	//Break Block
+	for (int i = 0; i < 200; i++) {
+		if (deadBodyStorage[i] != NULL)
+			Remove(deadBodyStorage[i]);
 		deadBodyStorage[i] = NULL;
 	}
-}
\ No newline at end of file
+}
+
+void World::WriteSnapshot(WorldSnapshot& snapshot) const
+{
+	snapshot.bodies.resize(bodies.size());
+	for (int i = 0; i < (int)bodies.size(); ++i)
+	{
+		const Body* b = bodies[i];
+		BodySnapshot& bs = snapshot.bodies[i];
+		bs.body = b;
+		GetInterpolatedTransform(b, &bs.position, &bs.rotation);
+		bs.width = b->width;
+		bs.boxes = b->boxes;
+		bs.exists = b->isItExist;
+	}
+
+	snapshot.joints.resize(joints.size());
+	for (int i = 0; i < (int)joints.size(); ++i)
+	{
+		const Joint* j = joints[i];
+		JointSnapshot& js = snapshot.joints[i];
+		js.position1 = j->body1->position;
+		js.anchor1 = js.position1 + Mat22(j->body1->rot) * j->localAnchor1;
+		js.position2 = j->body2->position;
+		js.anchor2 = js.position2 + Mat22(j->body2->rot) * j->localAnchor2;
+	}
+
+	snapshot.contacts.clear();
+	for (map<ArbiterKey, Arbiter>::const_iterator arb = arbiters.begin(); arb != arbiters.end(); ++arb)
+	{
+		for (int i = 0; i < arb->second.numContacts; ++i)
+		{
+			const Contact& c = arb->second.contacts[i];
+			ContactSnapshot cs;
+			cs.position = c.position;
+			cs.normal = c.normal;
+			cs.separation = c.separation;
+			snapshot.contacts.push_back(cs);
+		}
+	}
+
+	snapshot.tiles.resize(tiles.rects.size());
+	for (int i = 0; i < (int)tiles.rects.size(); ++i)
+	{
+		BoxTransform xf = tiles.GetRectTransform(i);
+		snapshot.tiles[i] = AABB(xf.position - xf.halfWidth, xf.position + xf.halfWidth);
+	}
+
+	snapshot.profile = profile;
+}
+
+// The worker sleeps until StepAsync hands it a step, then fills the back
+// snapshot so the caller can keep reading the front one.
+void World::AsyncLoop()
+{
+	std::unique_lock<std::mutex> lock(asyncMutex);
+	for (;;)
+	{
+		while (!stepPending && !quit)
+			asyncCondition.wait(lock);
+
+		if (quit)
+			return;
+
+		float dt = asyncDt;
+		bool fixed = asyncFixed;
+		lock.unlock();
+
+		if (fixed)
+			Advance(dt);
+		else
+			Step(dt);
+		WriteSnapshot(snapshots[1 - frontSnapshot]);
+
+		lock.lock();
+		stepPending = false;
+		stepDone = true;
+		asyncCondition.notify_all();
+	}
+}
+
+void World::StepAsync(float dt)
+{
+	WaitStep();
+
+	if (!worker.joinable())
+		worker = std::thread(&World::AsyncLoop, this);
+
+	{
+		std::lock_guard<std::mutex> lock(asyncMutex);
+		asyncDt = dt;
+		asyncFixed = false;
+		stepPending = true;
+	}
+	asyncCondition.notify_all();
+}
+
+void World::AdvanceAsync(float elapsedTime)
+{
+	WaitStep();
+
+	if (!worker.joinable())
+		worker = std::thread(&World::AsyncLoop, this);
+
+	{
+		std::lock_guard<std::mutex> lock(asyncMutex);
+		asyncDt = elapsedTime;
+		asyncFixed = true;
+		stepPending = true;
+	}
+	asyncCondition.notify_all();
+}
+
+void World::WaitStep()
+{
+	std::unique_lock<std::mutex> lock(asyncMutex);
+	while (stepPending)
+		asyncCondition.wait(lock);
+
+	if (stepDone)
+	{
+		frontSnapshot = 1 - frontSnapshot;
+		stepDone = false;
+	}
+}